@@ -10,7 +10,7 @@ simcpp20::event<> producer(simcpp20::simulation<> &sim,
                            simcpp20::filtered_store<int>& store) {
   for (int i = 0; i < 10; ++i) {
     co_await sim.timeout(1);
-    co_await store.put(i);  
+    store.try_put(i);
   }
 }
 
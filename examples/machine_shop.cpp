@@ -3,8 +3,6 @@
 
 // See https://simpy.readthedocs.io/en/latest/examples/machine_shop.html
 
-// TODO(fschuetz04): Memory leak
-
 #include "simcpp20/simcpp20.hpp"
 #include "simcpp20/resource.hpp"
 
@@ -13,7 +11,8 @@
 
 struct config {
   double repair_time;
-  simcpp20::resource<> repair_man;
+  double job_duration;
+  simcpp20::preemptive_resource<> repair_man;
   std::normal_distribution<> time_for_part_dist;
   std::exponential_distribution<> time_to_failure_dist;
   std::default_random_engine gen;
@@ -22,8 +21,7 @@ struct config {
 class machine {
 public:
   machine(simcpp20::simulation<> &sim, config &conf)
-      : sim{sim}, conf{conf}, failure{sim.event()} {
-    produce();
+      : sim{sim}, conf{conf}, process{produce()} {
     fail();
   }
 
@@ -37,20 +35,23 @@ private:
 
       while (true) {
         double start = sim.now();
-        auto timeout = sim.timeout(time_for_part);
-        co_await(timeout | failure);
-
-        if (timeout.triggered()) {
+        try {
+          co_await sim.timeout(time_for_part);
           // part is finished
           ++n_parts_made;
           break;
+        } catch (const simcpp20::interrupted &) {
+          // machine failed, calculate remaining time for part
+          time_for_part -= sim.now() - start;
+          broken = true;
         }
 
-        // machine failed, calculate remaining time for part and wait for repair
-        time_for_part -= sim.now() - start;
-        co_await conf.repair_man.request();
+        // wait for repair
+        auto request = conf.repair_man.request(1);
+        co_await request;
         co_await sim.timeout(conf.repair_time);
-        conf.repair_man.release();
+        conf.repair_man.release(request);
+        broken = false;
       }
     }
   }
@@ -58,22 +59,48 @@ private:
   simcpp20::event<> fail() {
     while (true) {
       co_await sim.timeout(conf.time_to_failure_dist(conf.gen));
-      failure.trigger();
-      failure = sim.event();
+      if (!broken) {
+        process.interrupt();
+      }
     }
   }
 
   config &conf;
-  simcpp20::event<> failure;
+  bool broken = false;
+  simcpp20::event<> process;
 };
 
+// the repair man works on other jobs when no machine needs to be repaired
+simcpp20::event<> other_jobs(simcpp20::simulation<> &sim, config &conf) {
+  while (true) {
+    double done_in = conf.job_duration;
+
+    while (done_in > 0) {
+      auto request = conf.repair_man.request(2);
+      co_await request;
+
+      auto preempted = conf.repair_man.preempted(request);
+      co_await(sim.timeout(done_in) | preempted);
+
+      if (preempted.triggered()) {
+        // a machine needs to be repaired, continue the job afterwards
+        done_in -= preempted.value().usage;
+      } else {
+        done_in = 0;
+      }
+      conf.repair_man.release(request);
+    }
+  }
+}
+
 int main() {
   simcpp20::simulation<> sim;
 
   std::random_device rd;
   config conf{
       .repair_time = 30,
-      .repair_man = simcpp20::resource{sim, 1},
+      .job_duration = 30,
+      .repair_man = simcpp20::preemptive_resource{sim, 1},
       .time_for_part_dist = std::normal_distribution<>{10, 2},
       .time_to_failure_dist = std::exponential_distribution<>{1. / 300},
       .gen = std::default_random_engine{rd()},
@@ -85,6 +112,7 @@ int main() {
   for (int i = 0; i < n_machines; ++i) {
     machines.emplace_back(sim, conf);
   }
+  other_jobs(sim, conf);
 
   int n_weeks = 4;
   sim.run_until(n_weeks * 7 * 24 * 60);
@@ -9,7 +9,7 @@
 simcpp20::event<> producer(simcpp20::simulation<> &sim,
                            simcpp20::store<int>& store) {
   co_await sim.timeout(3);
-  co_await store.put(42);
+  store.try_put(42);
 }
 
 simcpp20::event<> consumer(simcpp20::simulation<> &sim,
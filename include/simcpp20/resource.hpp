@@ -3,112 +3,1815 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <type_traits>
 #include <queue>
 #include <list>
 #include <vector>
 #include <tuple>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <memory>
 
 #include "simcpp20/simcpp20.hpp"
+#include "simcpp20/indexed_heap.hpp"
+#include "simcpp20/ring_buffer.hpp"
+#include "simcpp20/wait_queue.hpp"
+#include "simcpp20/statistics.hpp"
 
 namespace simcpp20 {
 
+/**
+ * Convert a delay computed in floating point to simulation time. For integral
+ * time types, a positive delay is rounded up to at least one unit of time, so
+ * a timeout waiting for remaining work or tokens always advances the
+ * simulation.
+ *
+ * @tparam Time Type used for simulation time.
+ * @param delay Delay in units of simulation time.
+ * @return Time delay converted to Time.
+ */
+template <class Time> Time delay_cast(double delay) {
+  if constexpr (std::is_integral_v<Time>) {
+    if (delay <= 0) {
+      return Time{0};
+    }
+    // ignore rounding errors which push an exact delay above an integer
+    auto ticks = std::ceil(delay - 1e-9 * std::max(1., delay));
+    return std::max(Time{1}, static_cast<Time>(ticks));
+  } else {
+    return static_cast<Time>(delay);
+  }
+}
+
 /**
  * Used to create a (discrete) shared resource.
  *
- * To create a new instance, default-initialize the class:
+ * To create a new instance, default-initialize the class:
+ *
+ *     simcpp20::resource<> resource;
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class resource {
+public:
+  resource(simcpp20::simulation<Time> &sim, uint64_t available)
+      : sim{sim}, available_{available} {}
+
+  resource(const resource &) = delete;
+  resource &operator=(const resource &) = delete;
+
+  /// Destructor. Cancels the scheduled capacity changes.
+  ~resource() {
+    for (auto &ev : schedules_) {
+      ev.abort();
+    }
+  }
+
+  simcpp20::event<Time> request() {
+    auto ev = sim.event();
+    evs.push(ev)->since_ = sim.now();
+    trigger_evs();
+    return ev;
+  }
+
+  void release() {
+    ++available_;
+    if (users_ > 0) {
+      --users_;
+    }
+    // a released unit pays off a pending capacity decrease first
+    auto paid = std::min(deficit_, available_);
+    deficit_ -= paid;
+    available_ -= paid;
+    trigger_evs();
+  }
+
+  uint64_t available() const { return available_; }
+
+  /**
+   * @return uint64_t number of units the resource has, including units still
+   * held by users beyond a decreased capacity.
+   */
+  uint64_t capacity() const { return available_ + users_ - deficit_; }
+
+  /**
+   * Change the number of units. An increase grants waiting requests
+   * immediately. A decrease takes available units first, and the rest as
+   * units are released, so no user loses its unit.
+   *
+   * @param capacity new number of units.
+   */
+  void set_capacity(uint64_t capacity) {
+    auto current = this->capacity();
+    if (capacity >= current) {
+      auto increase = capacity - current;
+      auto paid = std::min(deficit_, increase);
+      deficit_ -= paid;
+      available_ += increase - paid;
+      trigger_evs();
+    } else {
+      auto decrease = current - capacity;
+      auto taken = std::min(available_, decrease);
+      available_ -= taken;
+      deficit_ += decrease - taken;
+      observe();
+    }
+  }
+
+  /**
+   * Change the number of units at the given simulation time, for example for
+   * shifts, maintenance windows or breakdowns. The change is applied by a
+   * scheduled event, so no process is needed. Destroying the resource cancels
+   * the change.
+   *
+   * @param at simulation time of the change. Must not be in the past.
+   * @param capacity new number of units.
+   * @return Scheduled event applying the change. Aborting it cancels the
+   * change.
+   */
+  simcpp20::event<Time> schedule_capacity(Time at, uint64_t capacity) {
+    auto ev = sim.timeout(at - sim.now());
+    ev.add_callback([this, capacity](const auto &) { set_capacity(capacity); });
+    track(ev);
+    return ev;
+  }
+
+  /**
+   * Let the number of units follow a calendar. Only the next change of each
+   * entry is scheduled at a time.
+   *
+   * A calendar without a period ends after its last change. A repeating
+   * calendar schedules changes forever, so run() only returns once its event
+   * is aborted. Otherwise, run the simulation with run_until(). Destroying the
+   * resource cancels its calendars.
+   *
+   *     auto shifts = resource.schedule_capacity({{0, 3}, {8, 1}}, 24);
+   *     ...
+   *     shifts.abort();
+   *
+   * @param changes simulation times and new numbers of units.
+   * @param period period after which the calendar repeats, or 0 if it does
+   * not repeat.
+   * @return New event which is triggered after the last change of a calendar
+   * without a period. Aborting it cancels the remaining changes.
+   */
+  simcpp20::event<Time>
+  schedule_capacity(const std::vector<std::pair<Time, uint64_t>> &changes,
+                    Time period = Time{0}) {
+    auto calendar = sim.event();
+    auto last = sim.now();
+    for (auto [at, capacity] : changes) {
+      last = std::max(last, at);
+    }
+    for (auto [at, capacity] : changes) {
+      schedule_change(calendar, at, capacity, period, last);
+    }
+    if (changes.empty()) {
+      calendar.trigger();
+    }
+    track(calendar);
+    return calendar;
+  }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  constexpr size_t waiting() const {
+    return evs.size();
+  }
+
+  /**
+   * Attach a monitor which records the number of units in use, the number of
+   * waiting requests and the waiting times from now on.
+   *
+   * @param monitor monitor to record into, or nullptr to detach it. Must
+   * outlive the resource or be detached.
+   */
+  void set_monitor(simcpp20::monitor<Time> *monitor) {
+    monitor_ = monitor;
+    if (monitor_ == nullptr) {
+      evs.set_abort_callback(nullptr);
+      return;
+    }
+
+    evs.set_abort_callback([this] { observe(); });
+    observe();
+  }
+
+protected:
+  /// Pending requests. Aborted requests are unlinked immediately.
+  wait_queue<simcpp20::event<Time>> evs{};
+  simcpp20::simulation<Time> &sim;
+  uint64_t available_;
+  /// Number of granted requests which were not released yet.
+  uint64_t users_ = 0;
+  /// Number of units to remove from the capacity when they are released.
+  uint64_t deficit_ = 0;
+  simcpp20::monitor<Time> *monitor_ = nullptr;
+  /// Pending scheduled changes and calendars, aborted on destruction.
+  std::vector<simcpp20::event<Time>> schedules_{};
+
+  /// @param ev pending scheduled change or calendar to cancel on destruction.
+  void track(const simcpp20::event<Time> &ev) {
+    std::erase_if(schedules_, [](const auto &e) { return !e.pending(); });
+    if (ev.pending()) {
+      schedules_.push_back(ev);
+    }
+  }
+
+  /**
+   * @param calendar event of the calendar the change belongs to.
+   * @param at simulation time of the change.
+   * @param capacity new number of units.
+   * @param period period after which the change repeats, or 0.
+   * @param last simulation time of the last change of the calendar.
+   */
+  void schedule_change(simcpp20::event<Time> calendar, Time at,
+                       uint64_t capacity, Time period, Time last) {
+    auto ev = sim.timeout(at - sim.now());
+    ev.add_callback([this, calendar, at, capacity, period,
+                     last](const auto &) {
+      // checked first, since an aborted calendar may belong to a destroyed
+      // resource
+      if (calendar.aborted()) {
+        return;
+      }
+
+      set_capacity(capacity);
+      if (period > Time{0}) {
+        schedule_change(calendar, at + period, capacity, period, last);
+      } else if (at == last) {
+        calendar.trigger();
+      }
+    });
+  }
+
+  void trigger_evs() {
+    while (available_ > 0 && !evs.empty()) {
+      if (monitor_ != nullptr) {
+        monitor_->record_waiting_time(sim.now() - evs.front()->since_);
+      }
+      evs.pop().trigger();
+      --available_;
+      ++users_;
+    }
+    observe();
+  }
+
+  /// Record the current state in the monitor, if any.
+  void observe() {
+    if (monitor_ != nullptr) {
+      monitor_->level.update(sim.now(), static_cast<double>(users_));
+      monitor_->queue_length.update(sim.now(), static_cast<double>(evs.size()));
+    }
+  }
+};
+
+/**
+ * Used to create a (discrete) shared resource whose requests are granted by
+ * priority. The lower the number the higher the priority. Requests with the
+ * same priority are granted in the order they were made.
+ *
+ * To create a new instance, initialize the class passing the simulation and
+ * the number of available units:
+ *
+ *     simcpp20::priority_resource<> resource{sim, 1};
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class priority_resource {
+  typedef std::tuple<int16_t, Time, id_type> pq_key;
+
+public:
+  priority_resource(simcpp20::simulation<Time> &sim, uint64_t available)
+      : sim{sim}, available_{available} {}
+
+  /**
+   * @param priority the priority of the request (the smaller value the higher
+   * priority).
+   * @return A new event that is triggered when a unit is granted to the request.
+   */
+  simcpp20::event<Time> request(int16_t priority = 0) {
+    auto ev = sim.event();
+    evs.push(ev, pq_key{priority, sim.now(), next_id_});
+    ++next_id_;
+    trigger_evs();
+    return ev;
+  }
+
+  void release() {
+    ++available_;
+    trigger_evs();
+  }
+
+  uint64_t available() const { return available_; }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  constexpr size_t waiting() const {
+    return evs.size();
+  }
+
+protected:
+  /// Pending requests ordered by priority, request time and sequence.
+  priority_wait_queue<simcpp20::event<Time>, pq_key> evs{};
+  simcpp20::simulation<Time> &sim;
+  uint64_t available_;
+  id_type next_id_ = 0;
+
+  void trigger_evs() {
+    while (available_ > 0 && !evs.empty()) {
+      evs.pop().trigger();
+      --available_;
+    }
+  }
+};
+
+/**
+ * Information delivered to the holder of a preemptive_resource unit when it is
+ * preempted by a request with higher priority.
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> struct preemption {
+  /// Simulation time at which the holder was preempted.
+  Time time;
+
+  /// Time the holder used the unit before it was preempted.
+  Time usage;
+};
+
+/**
+ * Used to create a (discrete) shared resource whose requests are granted by
+ * priority and where a request can preempt the holder of a unit with lower
+ * priority. The lower the number the higher the priority.
+ *
+ * Each granted request must be released with release(request), even if it was
+ * preempted. The holder can await preempted(request) to be notified when the
+ * unit is taken away:
+ *
+ *     auto request = resource.request(1);
+ *     co_await request;
+ *     auto preempted = resource.preempted(request);
+ *     co_await (sim.timeout(duration) | preempted);
+ *     resource.release(request);
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class preemptive_resource {
+  typedef std::tuple<int16_t, Time, id_type> pq_key;
+
+public:
+  preemptive_resource(simcpp20::simulation<Time> &sim, uint64_t available)
+      : sim{sim}, available_{available} {}
+
+  /**
+   * @param priority the priority of the request (the smaller value the higher
+   * priority).
+   * @param preempt whether the request preempts the holder with the lowest
+   * priority if no unit is available and that priority is lower than its own.
+   * @return A new event that is triggered when a unit is granted to the request.
+   */
+  simcpp20::event<Time> request(int16_t priority = 0, bool preempt = true) {
+    auto ev = sim.event();
+    auto key = pq_key{priority, sim.now(), next_id_};
+    ++next_id_;
+
+    if (preempt && available_ == 0 && !users_.empty()) {
+      auto worst = std::prev(users_.end());
+      if (priority < std::get<0>(worst->first)) {
+        evict(worst);
+      }
+    }
+
+    evs.push(ev, key);
+    trigger_evs();
+    return ev;
+  }
+
+  /**
+   * Release the unit granted to a request. If the request was preempted, only
+   * its bookkeeping is removed.
+   *
+   * @param request Event returned by request().
+   */
+  void release(const simcpp20::event<Time> &request) {
+    auto it = holders_.find(request);
+    if (it == holders_.end()) {
+      return;
+    }
+
+    if (it->second.active_) {
+      users_.erase(it->second.key_);
+      ++available_;
+    }
+    holders_.erase(it);
+    trigger_evs();
+  }
+
+  /**
+   * @param request Granted event returned by request().
+   * @return Value event triggered when the unit granted to the request is
+   * preempted.
+   */
+  simcpp20::value_event<preemption<Time>, Time>
+  preempted(const simcpp20::event<Time> &request) const {
+    auto it = holders_.find(request);
+    assert(it != holders_.end());
+    return it->second.preempted_;
+  }
+
+  uint64_t available() const { return available_; }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  constexpr size_t waiting() const {
+    return evs.size();
+  }
+
+  /**
+   * @return size_t number of units currently held.
+   */
+  size_t users() const {
+    return users_.size();
+  }
+
+protected:
+  /// Bookkeeping of a granted request.
+  struct holder {
+    /// Key the request was queued with.
+    pq_key key_;
+
+    /// Simulation time at which the unit was granted.
+    Time since_;
+
+    /// Event triggered when the unit is preempted.
+    simcpp20::value_event<preemption<Time>, Time> preempted_;
+
+    /// Whether the request still holds its unit.
+    bool active_ = true;
+  };
+
+  typedef std::map<pq_key, simcpp20::event<Time>> users_type;
+
+  /// Pending requests ordered by priority, request time and sequence.
+  priority_wait_queue<simcpp20::event<Time>, pq_key> evs{};
+  /// Granted requests which were not released yet.
+  std::unordered_map<simcpp20::event<Time>, holder> holders_{};
+  /// Requests holding a unit, ordered by key. The last one is preempted first.
+  users_type users_{};
+  simcpp20::simulation<Time> &sim;
+  uint64_t available_;
+  id_type next_id_ = 0;
+
+  void trigger_evs() {
+    while (available_ > 0 && !evs.empty()) {
+      auto key = evs.front()->key_;
+      auto ev = evs.pop();
+      ev.trigger();
+      --available_;
+
+      holders_.emplace(
+          ev, holder{key, sim.now(),
+                     sim.template event<preemption<Time>>()});
+      users_.emplace(key, ev);
+    }
+  }
+
+  void evict(typename users_type::iterator it) {
+    auto &h = holders_.at(it->second);
+    h.active_ = false;
+    users_.erase(it);
+    ++available_;
+    h.preempted_.trigger(preemption<Time>{sim.now(), sim.now() - h.since_});
+  }
+};
+
+/**
+ * Used to create a processor-sharing server, such as a CPU or a network link.
+ * All jobs in service share the service rate in proportion to their weights,
+ * so with equal weights the server is egalitarian.
+ *
+ * Completion times are tracked in virtual time, which advances at the rate
+ * each unit of weight is served at. A job finishes when virtual time reaches
+ * its virtual finish time, which never changes after its arrival. Jobs are
+ * kept in a heap ordered by virtual finish time, so arrivals and departures
+ * take O(log n), and only the next departure is scheduled.
+ *
+ * To create a new instance, initialize the class passing the simulation and
+ * the service rate:
+ *
+ *     simcpp20::processor_sharing<> cpu{sim, 2};
+ *     co_await cpu.serve(10);
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class processor_sharing {
+  typedef std::tuple<double, id_type> pq_key;
+
+public:
+  /**
+   * @param sim Simulation.
+   * @param rate Amount of work served per unit of time.
+   */
+  processor_sharing(simcpp20::simulation<Time> &sim, double rate = 1)
+      : sim{sim}, rate_{rate}, last_{sim.now()} {
+    assert(rate > 0);
+    evs.set_abort_callback([this](double weight) { withdraw(weight); });
+  }
+
+  processor_sharing(const processor_sharing &) = delete;
+  processor_sharing &operator=(const processor_sharing &) = delete;
+
+  /// Destructor. Cancels the scheduled departure.
+  ~processor_sharing() {
+    if (timer_) {
+      timer_->abort();
+    }
+  }
+
+  /**
+   * @param work amount of work of the job.
+   * @param weight share of the job relative to the other jobs in service.
+   * @return A new event that is triggered when the job is served completely.
+   * Aborting it withdraws the job.
+   */
+  simcpp20::event<Time> serve(double work, double weight = 1) {
+    assert(work >= 0 && weight > 0);
+
+    auto ev = sim.event();
+    if (work == 0) {
+      ev.trigger();
+      return ev;
+    }
+
+    advance();
+    evs.push(ev, pq_key{vtime_ + work / weight, next_id_}, weight);
+    ++next_id_;
+    weight_ += weight;
+    schedule();
+    return ev;
+  }
+
+  /**
+   * @return size_t number of jobs in service.
+   */
+  size_t jobs() const { return evs.size(); }
+
+  /**
+   * @return double amount of work served per unit of time.
+   */
+  double rate() const { return rate_; }
+
+protected:
+  /// Jobs in service with their weights, ordered by virtual finish time.
+  priority_wait_queue<simcpp20::event<Time>, pq_key, double> evs{};
+  simcpp20::simulation<Time> &sim;
+  double rate_;
+  /// Virtual time at the simulation time last_.
+  double vtime_ = 0;
+  Time last_;
+  /// Sum of the weights of the jobs in service.
+  double weight_ = 0;
+  /// Timeout of the next departure, if scheduled.
+  std::optional<simcpp20::event<Time>> timer_{};
+  Time timer_at_{};
+  id_type next_id_ = 0;
+
+  /// Advance virtual time to the current simulation time.
+  void advance() {
+    if (weight_ > 0) {
+      vtime_ += static_cast<double>(sim.now() - last_) * rate_ / weight_;
+    }
+    last_ = sim.now();
+  }
+
+  /**
+   * Make sure a timeout fires no later than the next departure. An arrival
+   * only delays the departures of the other jobs, so a scheduled timeout is
+   * kept if it is not late and rechecks the jobs when it fires.
+   */
+  void schedule() {
+    if (evs.empty()) {
+      return;
+    }
+
+    auto remaining = std::max(0., std::get<0>(evs.front()->key_) - vtime_);
+    auto at = sim.now() + delay_cast<Time>(remaining * weight_ / rate_);
+    if (timer_ && timer_->pending() && timer_at_ <= at) {
+      return;
+    }
+
+    if (timer_) {
+      timer_->abort();
+    }
+    timer_ = sim.timeout(at - sim.now());
+    timer_at_ = at;
+    timer_->add_callback([this](const auto &) { depart(); });
+  }
+
+  /// Complete all jobs whose virtual finish time was reached.
+  void depart() {
+    timer_.reset();
+    advance();
+
+    while (!evs.empty()) {
+      auto finish = std::get<0>(evs.front()->key_);
+      // tolerate rounding errors accumulated in virtual time
+      if (finish - vtime_ > 1e-9 * std::max(1., std::abs(finish))) {
+        break;
+      }
+      weight_ -= evs.front()->payload_;
+      evs.pop().trigger();
+    }
+    if (evs.empty()) {
+      weight_ = 0;
+    }
+
+    schedule();
+  }
+
+  /// @param weight weight of a withdrawn job, whose share is removed.
+  void withdraw(double weight) {
+    advance();
+    weight_ -= weight;
+    if (evs.empty()) {
+      weight_ = 0;
+    }
+    schedule();
+  }
+};
+
+/// Policies assigning the jobs of a server_pool to its servers.
+enum class dispatch_policy {
+  /// Servers in turn.
+  round_robin,
+
+  /// Server with the fewest jobs, queued or in service.
+  shortest_queue,
+
+  /// Server with the fewest jobs among d servers sampled at random.
+  power_of_d,
+
+  /// Server which finishes its queued and running jobs first.
+  least_work_left
+};
+
+/**
+ * Used to create a pool of servers with different speeds, each serving its
+ * own queue of jobs in FIFO order. A dispatch policy assigns each submitted
+ * job to a server. The servers are kept in an indexed heap ordered by the
+ * number of jobs or by the time they become idle, so a dispatch takes
+ * O(log n) instead of scanning all servers.
+ *
+ * To create a new instance, initialize the class passing the simulation, the
+ * speeds of the servers and the policy:
+ *
+ *     simcpp20::server_pool<> pool{sim, {1, 1, 2},
+ *                                  simcpp20::dispatch_policy::least_work_left};
+ *     auto server = co_await pool.submit(10);
+ *
+ * The pool must outlive the jobs in service.
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class server_pool {
+public:
+  /**
+   * @param sim Simulation.
+   * @param speeds amount of work each server serves per unit of time.
+   * @param policy dispatch policy.
+   * @param d number of servers sampled by dispatch_policy::power_of_d.
+   * @param seed seed of the random number generator used by
+   * dispatch_policy::power_of_d.
+   */
+  server_pool(simcpp20::simulation<Time> &sim, const std::vector<double> &speeds,
+              dispatch_policy policy = dispatch_policy::shortest_queue,
+              std::size_t d = 2, std::uint64_t seed = 0)
+      : sim{sim}, policy_{policy}, d_{d}, rng_{seed},
+        heap_(std::vector<double>(speeds.size(), 0)) {
+    assert(!speeds.empty() && d > 0);
+
+    servers_.reserve(speeds.size());
+    for (auto speed : speeds) {
+      assert(speed > 0);
+      servers_.emplace_back(speed);
+    }
+    for (std::size_t i = 0; i < servers_.size(); ++i) {
+      servers_[i].evs_.set_abort_callback(
+          [this, i](double work) { withdraw(i, work); });
+    }
+  }
+
+  server_pool(const server_pool &) = delete;
+  server_pool &operator=(const server_pool &) = delete;
+
+  /**
+   * @param work amount of work of the job.
+   * @return A new value event that is triggered with the index of the server
+   * when the job is served. Aborting it while the job is queued withdraws the
+   * job.
+   */
+  simcpp20::value_event<std::size_t, Time> submit(double work) {
+    assert(work >= 0);
+
+    auto i = choose();
+    auto &s = servers_[i];
+    auto ev = sim.template event<std::size_t>();
+    s.evs_.push(ev, work);
+    ++s.jobs_;
+    s.idle_at_ = std::max(s.idle_at_, static_cast<double>(sim.now())) +
+                 work / s.speed_;
+    update(i);
+    start(i);
+    return ev;
+  }
+
+  /**
+   * @return size_t number of servers.
+   */
+  size_t size() const { return servers_.size(); }
+
+  /**
+   * @param server index of the server.
+   * @return size_t number of jobs queued at or served by the server.
+   */
+  size_t jobs(std::size_t server) const { return servers_[server].jobs_; }
+
+protected:
+  /// One server with its queue.
+  struct server {
+    explicit server(double speed) : speed_{speed} {}
+
+    double speed_;
+    /// Queued jobs with their work. Aborted jobs are unlinked immediately.
+    wait_queue<simcpp20::value_event<std::size_t, Time>, double> evs_{};
+    /// Number of queued jobs plus the job in service, if any.
+    std::size_t jobs_ = 0;
+    bool busy_ = false;
+    /// Simulation time at which the job in service finishes.
+    double busy_until_ = 0;
+    /// Simulation time at which all jobs of the server are finished.
+    double idle_at_ = 0;
+  };
+
+  simcpp20::simulation<Time> &sim;
+  std::vector<server> servers_{};
+  dispatch_policy policy_;
+  std::size_t d_;
+  std::mt19937_64 rng_;
+  /// Servers ordered by the key of the policy, if it uses one.
+  indexed_heap<double> heap_;
+  std::size_t next_ = 0;
+
+  /// @return Index of the server to assign the next job to.
+  std::size_t choose() {
+    switch (policy_) {
+    case dispatch_policy::round_robin:
+      return next_++ % servers_.size();
+    case dispatch_policy::power_of_d: {
+      std::uniform_int_distribution<std::size_t> dist{0, servers_.size() - 1};
+      auto best = dist(rng_);
+      for (std::size_t k = 1; k < d_; ++k) {
+        auto i = dist(rng_);
+        if (servers_[i].jobs_ < servers_[best].jobs_) {
+          best = i;
+        }
+      }
+      return best;
+    }
+    default:
+      return heap_.top();
+    }
+  }
+
+  /// @param i index of a server whose key changed.
+  void update(std::size_t i) {
+    if (policy_ == dispatch_policy::shortest_queue) {
+      heap_.update(i, static_cast<double>(servers_[i].jobs_));
+    } else if (policy_ == dispatch_policy::least_work_left) {
+      heap_.update(i, servers_[i].idle_at_);
+    }
+  }
+
+  /// @param i index of a server which may start its next job.
+  void start(std::size_t i) {
+    auto &s = servers_[i];
+    if (s.busy_ || s.evs_.empty()) {
+      return;
+    }
+
+    auto duration = s.evs_.front()->payload_ / s.speed_;
+    auto ev = s.evs_.pop();
+    s.busy_ = true;
+    s.busy_until_ = static_cast<double>(sim.now()) + duration;
+    sim.timeout(delay_cast<Time>(duration))
+        .add_callback([this, i, ev](const auto &) {
+          auto &s = servers_[i];
+          s.busy_ = false;
+          --s.jobs_;
+          update(i);
+          ev.trigger(i);
+          start(i);
+        });
+  }
+
+  /**
+   * @param i index of a server whose queued job was withdrawn.
+   * @param work amount of work of the withdrawn job.
+   */
+  void withdraw(std::size_t i, double work) {
+    auto &s = servers_[i];
+    --s.jobs_;
+    s.idle_at_ -= work / s.speed_;
+    if (s.evs_.empty()) {
+      // avoid accumulating rounding errors
+      s.idle_at_ = s.busy_ ? s.busy_until_ : static_cast<double>(sim.now());
+    }
+    update(i);
+  }
+};
+
+/**
+ * Used to create a container holding a continuous or discrete level, such as
+ * a tank or a pool of tokens. Puts wait while the level would exceed the
+ * capacity, gets wait while the level is too low. Waiting puts and gets are
+ * satisfied in the order they were made, so only the first waiting put and get
+ * have to be checked when the level changes.
+ *
+ * To create a new instance, initialize the class passing the simulation, the
+ * capacity and the initial level:
+ *
+ *     simcpp20::container<> tank{sim, 100, 50};
+ *
+ * @tparam Level Type used for the level.
+ * @tparam Time Type used for simulation time.
+ */
+template <typename Level = double, typename Time = double> class container {
+public:
+  container(simcpp20::simulation<Time> &sim, Level capacity,
+            Level level = Level{0})
+      : sim{sim}, capacity_{capacity}, level_{level} {
+    assert(level_ >= Level{0} && level_ <= capacity_);
+
+    // an aborted first waiter may have blocked the waiters behind it
+    put_evs.set_abort_callback([this] { trigger_evs(); });
+    get_evs.set_abort_callback([this] { trigger_evs(); });
+  }
+
+  container(const container &) = delete;
+  container &operator=(const container &) = delete;
+
+  /**
+   * @param amount amount to add to the level.
+   * @return A new event that is triggered when the amount was added.
+   */
+  simcpp20::event<Time> put(Level amount) {
+    assert(amount >= Level{0} && amount <= capacity_);
+
+    auto ev = sim.event();
+    put_evs.push(ev, amount);
+    trigger_evs();
+    return ev;
+  }
+
+  /**
+   * @param amount amount to remove from the level.
+   * @return A new event that is triggered when the amount was removed.
+   */
+  simcpp20::event<Time> get(Level amount) {
+    assert(amount >= Level{0} && amount <= capacity_);
+
+    auto ev = sim.event();
+    get_evs.push(ev, amount);
+    trigger_evs();
+    return ev;
+  }
+
+  /**
+   * @return Current level.
+   */
+  Level level() const { return level_; }
+
+  /**
+   * @return Maximum level.
+   */
+  Level capacity() const { return capacity_; }
+
+  /**
+   * @return size_t number of waiting puts.
+   */
+  size_t waiting_puts() const { return put_evs.size(); }
+
+  /**
+   * @return size_t number of waiting gets.
+   */
+  size_t waiting_gets() const { return get_evs.size(); }
+
+protected:
+  void trigger_evs() {
+    // every satisfied put may unblock the first get and vice versa
+    bool progress = true;
+    while (progress) {
+      progress = false;
+
+      while (!get_evs.empty() && get_evs.front()->payload_ <= level_) {
+        level_ -= get_evs.front()->payload_;
+        get_evs.pop().trigger();
+        progress = true;
+      }
+
+      while (!put_evs.empty() &&
+             put_evs.front()->payload_ <= capacity_ - level_) {
+        level_ += put_evs.front()->payload_;
+        put_evs.pop().trigger();
+        progress = true;
+      }
+    }
+  }
+
+protected:
+  simcpp20::simulation<Time> &sim;
+  /// Pending puts with the amount to add.
+  wait_queue<simcpp20::event<Time>, Level> put_evs{};
+  /// Pending gets with the amount to remove.
+  wait_queue<simcpp20::event<Time>, Level> get_evs{};
+  Level capacity_;
+  Level level_;
+};
+
+/**
+ * Used to create a token bucket limiting the rate of an activity, such as
+ * requests to an API or packets on a link. Tokens accumulate at a fixed rate
+ * up to the size of the bucket. The level is computed from the elapsed
+ * simulation time when needed, so no refill process is required, and only
+ * the first waiting acquisition has a timeout scheduled, for the exact time
+ * enough tokens accumulate. Acquisitions are granted in the order they were
+ * made.
+ *
+ * To create a new instance, initialize the class passing the simulation, the
+ * rate, the size of the bucket and the initial number of tokens:
+ *
+ *     simcpp20::token_bucket<> bucket{sim, 10, 20, 20};
+ *     co_await bucket.acquire(5);
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class token_bucket {
+public:
+  /**
+   * @param sim Simulation.
+   * @param rate number of tokens added per unit of time.
+   * @param burst maximum number of tokens.
+   * @param tokens initial number of tokens.
+   */
+  token_bucket(simcpp20::simulation<Time> &sim, double rate, double burst,
+               double tokens = 0)
+      : sim{sim}, rate_{rate}, burst_{burst}, tokens_{std::min(tokens, burst)},
+        last_{sim.now()} {
+    assert(rate > 0 && burst > 0);
+    // an aborted acquisition at the front may unblock the ones behind it
+    evs.set_abort_callback([this] { trigger_evs(); });
+  }
+
+  token_bucket(const token_bucket &) = delete;
+  token_bucket &operator=(const token_bucket &) = delete;
+
+  /// Destructor. Cancels the scheduled timeout.
+  ~token_bucket() {
+    if (timer_) {
+      timer_->abort();
+    }
+  }
+
+  /**
+   * @param n number of tokens to acquire. Must not exceed the size of the
+   * bucket.
+   * @return A new event that is triggered when the tokens are acquired.
+   */
+  simcpp20::event<Time> acquire(double n = 1) {
+    assert(n >= 0 && n <= burst_);
+
+    auto ev = sim.event();
+    auto first = evs.empty();
+    evs.push(ev, n);
+    if (first) {
+      // otherwise, the acquisition waits behind the first one and its timeout
+      trigger_evs();
+    }
+    return ev;
+  }
+
+  /**
+   * Acquire tokens without waiting, if no earlier acquisition is waiting.
+   *
+   * @param n number of tokens to acquire.
+   * @return bool whether the tokens were acquired.
+   */
+  bool try_acquire(double n = 1) {
+    refill();
+    if (!evs.empty() || tokens_ < n) {
+      return false;
+    }
+
+    tokens_ -= n;
+    return true;
+  }
+
+  /**
+   * @return double number of tokens currently in the bucket.
+   */
+  double tokens() {
+    refill();
+    return tokens_;
+  }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  size_t waiting() const { return evs.size(); }
+
+protected:
+  /// Pending acquisitions with their numbers of tokens.
+  wait_queue<simcpp20::event<Time>, double> evs{};
+  simcpp20::simulation<Time> &sim;
+  double rate_;
+  double burst_;
+  /// Number of tokens at the simulation time last_.
+  double tokens_;
+  Time last_;
+  /// Timeout of the first waiting acquisition, if scheduled.
+  std::optional<simcpp20::event<Time>> timer_{};
+  /// Number of tokens of the acquisition the timeout was scheduled for.
+  double timer_n_ = 0;
+
+  /// Add the tokens accumulated since the last refill.
+  void refill() {
+    auto elapsed = static_cast<double>(sim.now() - last_);
+    tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    last_ = sim.now();
+  }
+
+  /**
+   * Grant waiting acquisitions, and schedule a timeout for the next one. The
+   * pending timeout is kept if its deadline did not move.
+   */
+  void trigger_evs() {
+    refill();
+    auto granted = false;
+    while (!evs.empty()) {
+      auto n = evs.front()->payload_;
+      // tolerate rounding errors of the scheduled time
+      if (tokens_ + 1e-9 * std::max(1., n) < n) {
+        break;
+      }
+      tokens_ = std::max(0., tokens_ - n);
+      evs.pop().trigger();
+      granted = true;
+    }
+
+    // tokens only accumulate while acquisitions wait, so the deadline only
+    // moves if tokens were taken or the first acquisition needs another number
+    if (timer_ && !granted && !evs.empty() &&
+        evs.front()->payload_ == timer_n_) {
+      return;
+    }
+
+    if (timer_) {
+      timer_->abort();
+      timer_.reset();
+    }
+    if (!evs.empty()) {
+      timer_n_ = evs.front()->payload_;
+      auto delay = (timer_n_ - tokens_) / rate_;
+      timer_ = sim.timeout(delay_cast<Time>(delay));
+      timer_->add_callback([this](const auto &) {
+        timer_.reset();
+        trigger_evs();
+      });
+    }
+  }
+};
+
+/**
+ * Used to create a (discrete) shared store for a given type.
+ *
+ * To create a new instance, initialize the class passing
+ * the type of the stored values.
+ *
+ *     simcpp20::resource<int> store;
+ *
+ * @tparam Value Type used for stored values.
+ * @tparam Time Type used for simulation time.
+ */
+
+template <typename Value, typename Time = double> class store {
+public:
+  /**
+   * @param sim Reference to the simulation.
+   * @param capacity maximum number of stored elements. A put() on a full store
+   * waits until a get() frees space.
+   */
+  store(simcpp20::simulation<Time> &sim,
+        size_t capacity = std::numeric_limits<size_t>::max())
+      : sim{sim}, capacity_{capacity} {
+    assert(capacity_ > 0);
+
+    // an aborted first get may have blocked the gets behind it
+    evs.set_abort_callback([this] { trigger_put(); });
+    batch_evs.set_abort_callback([this] { trigger_put(); });
+  }
+
+  store(const store &) = delete;
+  store &operator=(const store &) = delete;
+
+  /**
+   * @tparam Args inferred types of the Value constructor.
+   * @param args arguments for the constructor of the Value associated the event.
+   * @return A new event that confirms the effect of the put operation. It is
+   * triggered immediately if the store is not full, or once space is freed
+   * otherwise. Waiting puts are served in FIFO order. The event is allocated
+   * and scheduled even if the store is not full; try_put() is the only put
+   * without an event, so use it if the confirmation is not needed.
+   */
+  template <typename... Args>
+  simcpp20::event<Time> put(Args &&...args) {
+    auto ev = sim.event();
+    if (can_hand_off()) {
+      pop_get().trigger(std::forward<Args>(args)...);
+      ev.trigger();
+    } else if (put_evs.empty() && queue_.size() < capacity_) {
+      queue_.push(std::forward<Args>(args)...);
+      ev.trigger();
+      trigger_put();
+    } else {
+      put_evs.push(ev, Value(std::forward<Args>(args)...));
+    }
+    observe();
+    return ev;
+  }
+
+  /**
+   * Put a value without creating a confirmation event, so no event is
+   * allocated and scheduled.
+   *
+   * @tparam Args inferred types of the Value constructor.
+   * @param args arguments for the constructor of the Value.
+   * @return Whether the value was stored. Always true if the store is not full.
+   */
+  template <typename... Args> bool try_put(Args &&...args) {
+    if (can_hand_off()) {
+      pop_get().trigger(std::forward<Args>(args)...);
+      observe();
+      return true;
+    }
+    if (!put_evs.empty() || queue_.size() >= capacity_) {
+      return false;
+    }
+
+    queue_.push(std::forward<Args>(args)...);
+    trigger_put();
+    return true;
+  }
+
+  /**
+   * Put all values of a range with a single confirmation event. The values are
+   * moved if the range is an rvalue container, and copied otherwise.
+   *
+   * @tparam Range inferred type of the range of values.
+   * @param values range of values to put in order.
+   * @return A new event that confirms the effect of the put operation for all
+   * values. If some values have to wait for space, it is the event of the last
+   * waiting put, so aborting it only withdraws the last value.
+   */
+  template <std::ranges::input_range Range>
+  simcpp20::event<Time> put_n(Range &&values) {
+    constexpr bool move = !std::is_lvalue_reference_v<Range> &&
+                          !std::ranges::view<std::remove_cvref_t<Range>>;
+
+    std::optional<simcpp20::event<Time>> last{};
+    for (auto &&value : values) {
+      if (put_evs.empty() && queue_.size() < capacity_) {
+        if constexpr (move) {
+          queue_.push(std::move(value));
+        } else {
+          queue_.push(value);
+        }
+      } else {
+        last = sim.event();
+        if constexpr (move) {
+          put_evs.push(*last, Value(std::move(value)));
+        } else {
+          put_evs.push(*last, Value(value));
+        }
+      }
+    }
+
+    if (!last) {
+      last = sim.event();
+      last->trigger();
+    }
+    trigger_put();
+    return *last;
+  }
+
+  /**
+   * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
+   */
+  simcpp20::value_event<Value, Time> get() {
+    auto ev = sim.template event<Value>();
+    if (evs.empty() && batch_evs.empty() && queue_.size() > 0) {
+      record_wait(sim.now());
+      ev.trigger(std::move(queue_.front()));
+      queue_.pop();
+      trigger_get();
+    } else {
+      evs.push(ev, next_id_)->since_ = sim.now();
+      ++next_id_;
+    }
+    observe();
+    return ev;
+  }
+
+  /**
+   * @param n number of values to retrieve. Must not exceed the capacity.
+   * @return A new value event that is triggered with exactly n values once
+   * they are available. Gets are served in FIFO order, so waiting gets made
+   * later wait behind it.
+   */
+  simcpp20::value_event<std::vector<Value>, Time> get_n(size_t n) {
+    assert(n > 0 && n <= capacity_);
+    return get_batch(n, n);
+  }
+
+  /**
+   * @param n maximum number of values to retrieve.
+   * @return A new value event that is triggered with at least one and at most n
+   * values once a value is available.
+   */
+  simcpp20::value_event<std::vector<Value>, Time> get_up_to(size_t n) {
+    assert(n > 0);
+    return get_batch(1, n);
+  }
+
+  /**
+   * @return size_t number of stored elements.
+   */
+
+  constexpr size_t size() const {
+    return queue_.size();
+  }
+
+  /**
+   * @return size_t maximum number of stored elements.
+   */
+  constexpr size_t capacity() const {
+    return capacity_;
+  }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  constexpr size_t waiting() const {
+    return evs.size() + batch_evs.size();
+  }
+
+  /**
+   * @return size_t number of waiting put events.
+   */
+  constexpr size_t waiting_puts() const {
+    return put_evs.size();
+  }
+
+  /**
+   * Attach a monitor which records the number of stored elements, the number
+   * of waiting gets and their waiting times from now on.
+   *
+   * @param monitor monitor to record into, or nullptr to detach it. Must
+   * outlive the store or be detached.
+   */
+  void set_monitor(simcpp20::monitor<Time> *monitor) {
+    monitor_ = monitor;
+    observe();
+  }
+
+protected:
+  /// Bounds and sequence number of a waiting batch get.
+  struct batch {
+    id_type id_;
+    size_t min_;
+    size_t max_;
+  };
+
+  /**
+   * @return Whether a value put now can be delivered directly into the value
+   * event of the first waiting get, bypassing the queue. This is the case if
+   * the queue is empty and the first waiting get is not a batch get.
+   */
+  bool can_hand_off() const {
+    auto single = evs.front();
+    auto multi = batch_evs.front();
+    return queue_.size() == 0 && single != nullptr &&
+           (multi == nullptr || single->payload_ < multi->payload_.id_);
+  }
+
+  /**
+   * @return First waiting get, removed from the queue after recording its
+   * waiting time.
+   */
+  simcpp20::value_event<Value, Time> pop_get() {
+    record_wait(evs.front()->since_);
+    return evs.pop();
+  }
+
+  /// @param since simulation time at which the served get was made.
+  void record_wait(Time since) {
+    if (monitor_ != nullptr) {
+      monitor_->record_waiting_time(sim.now() - since);
+    }
+  }
+
+  /// Record the current state in the monitor, if any.
+  void observe() {
+    if (monitor_ != nullptr) {
+      monitor_->level.update(sim.now(), static_cast<double>(queue_.size()));
+      monitor_->queue_length.update(sim.now(), static_cast<double>(waiting()));
+    }
+  }
+
+  simcpp20::value_event<std::vector<Value>, Time> get_batch(size_t min,
+                                                            size_t max) {
+    auto ev = sim.template event<std::vector<Value>>();
+    if (evs.empty() && batch_evs.empty() && queue_.size() >= min) {
+      record_wait(sim.now());
+      ev.trigger(take(max));
+      trigger_get();
+    } else {
+      batch_evs.push(ev, batch{next_id_, min, max})->since_ = sim.now();
+      ++next_id_;
+    }
+    observe();
+    return ev;
+  }
+
+  /**
+   * @param max maximum number of values to take.
+   * @return Up to max values removed from the front of the queue.
+   */
+  std::vector<Value> take(size_t max) {
+    std::vector<Value> values;
+    values.reserve(std::min(max, queue_.size()));
+    while (values.size() < max && queue_.size() > 0) {
+      values.push_back(std::move(queue_.front()));
+      queue_.pop();
+    }
+    return values;
+  }
+
+  void trigger_put() {
+    // a put has been made and a number of waiting events could be triggered,
+    // in the order they were made
+    while (true) {
+      auto single = evs.front();
+      auto multi = batch_evs.front();
+      if (single == nullptr && multi == nullptr) {
+        break;
+      }
+
+      if (multi == nullptr ||
+          (single != nullptr && single->payload_ < multi->payload_.id_)) {
+        if (queue_.size() == 0) {
+          break;
+        }
+        // leave the store consistent before triggering, since a select
+        // decided by the trigger may abort other gets and re-enter the loop
+        auto value = std::move(queue_.front());
+        queue_.pop();
+        pop_get().trigger(std::move(value));
+      } else {
+        if (queue_.size() < multi->payload_.min_) {
+          break;
+        }
+        auto max = multi->payload_.max_;
+        record_wait(multi->since_);
+        batch_evs.pop().trigger(take(max));
+      }
+
+      trigger_get();
+    }
+    observe();
+  }
+
+  void trigger_get() {
+    // a get has been made and a number of waiting puts could be admitted
+    while (!put_evs.empty() && queue_.size() < capacity_) {
+      queue_.push(std::move(put_evs.front()->payload_));
+      put_evs.pop().trigger();
+    }
+  }
+
+protected:
+  simcpp20::simulation<Time> &sim;
+  /// Pending gets with their sequence numbers. Aborted gets are unlinked
+  /// immediately.
+  wait_queue<simcpp20::value_event<Value, Time>, id_type> evs{};
+  /// Pending batch gets with their bounds and sequence numbers.
+  wait_queue<simcpp20::value_event<std::vector<Value>, Time>, batch>
+      batch_evs{};
+  /// Pending puts with their values, waiting for space.
+  wait_queue<simcpp20::event<Time>, Value> put_evs{};
+  ring_buffer<Value> queue_;
+  size_t capacity_;
+  id_type next_id_ = 0;
+  simcpp20::monitor<Time> *monitor_ = nullptr;
+};
+
+/**
+ * Used to create a (discrete) shared store for a given type with a filtering get.
+ *
+ * To create a new instance, initialize the class passing
+ * the type of the stored values.
+ *
+ *     simcpp20::resource<int> filtered_store;
+ *
+ * @tparam Value Type used for stored values.
+ * @tparam Time Type used for simulation time.
+ */
+
+template <typename Value, typename Time = double> class filtered_store {
+public:
+  filtered_store(simcpp20::simulation<Time> &sim) : sim{sim} {}
+
+  filtered_store(const filtered_store &) = delete;
+  filtered_store &operator=(const filtered_store &) = delete;
+
+  /**
+   * @tparam Args inferred types of the Value constructor.
+   * @param args arguments for the constructor of the Value associated the event.
+   * @return A new triggered event that confirms the effect of the put operation.
+   * It is allocated and scheduled although the store is unbounded; use
+   * try_put() if the confirmation is not needed.
+   */
+  template <typename... Args>
+  simcpp20::event<Time> put(Args &&...args) {
+    auto ev = sim.event();
+    try_put(std::forward<Args>(args)...);
+    ev.trigger();
+    return ev;
+  }
+
+  /**
+   * Put a value without creating a confirmation event, so no event is
+   * allocated and scheduled.
+   *
+   * @tparam Args inferred types of the Value constructor.
+   * @param args arguments for the constructor of the Value.
+   * @return Whether the value was stored. Always true, since the store is
+   * unbounded.
+   */
+  template <typename... Args> bool try_put(Args &&...args) {
+    if (evs.empty()) {
+      list_.emplace_back(std::forward<Args>(args)...);
+      observe();
+      return true;
+    }
+
+    // deliver the value directly to the oldest matching get, if any
+    Value value(std::forward<Args>(args)...);
+    for (auto e = evs.front(); e != nullptr; e = e->next()) {
+      if (e->payload_(value)) {
+        auto ev = e->ev_;
+        record_wait(e->since_);
+        evs.erase(e);
+        ev.trigger(std::move(value));
+        observe();
+        return true;
+      }
+    }
+
+    list_.push_back(std::move(value));
+    observe();
+    return true;
+  }
+
+  /**
+   * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
+  */
+  simcpp20::value_event<Value, Time> get() {
+    std::function<bool(const Value& v)> p = [](const Value&) { return true; };
+    return get(p);
+  }
+
+
+  /**
+   * @param p a predicate that states the conditions that must hold of retrieving a value.
+   * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
+   */
+  simcpp20::value_event<Value, Time> get(std::function<bool(const Value& v)> p) {
+    auto ev = sim.template event<Value>();
+    trigger_get(ev, std::move(p));
+    return ev;
+  }
+
+  /**
+   * @return size_t number of stored elements.
+   */
+
+  constexpr size_t size() const {
+    return list_.size();
+  }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  constexpr size_t waiting() const {
+    return evs.size();
+  }
+
+  /**
+   * Attach a monitor which records the number of stored elements, the number
+   * of waiting gets and their waiting times from now on.
+   *
+   * @param monitor monitor to record into, or nullptr to detach it. Must
+   * outlive the store or be detached.
+   */
+  void set_monitor(simcpp20::monitor<Time> *monitor) {
+    monitor_ = monitor;
+    if (monitor_ == nullptr) {
+      evs.set_abort_callback(nullptr);
+      return;
+    }
+
+    evs.set_abort_callback([this] { observe(); });
+    observe();
+  }
+
+protected:
+  void trigger_get(simcpp20::value_event<Value, Time>& ev, std::function<bool(const Value& v)> p) {
+    auto it = std::find_if(list_.begin(), list_.end(), p);
+    if (it != list_.end()) {
+      record_wait(sim.now());
+      ev.trigger(std::move(*it));
+      it = list_.erase(it);
+    } else {
+      evs.push(ev, std::move(p))->since_ = sim.now();
+    }
+    observe();
+  }
+
+  /// @param since simulation time at which the served get was made.
+  void record_wait(Time since) {
+    if (monitor_ != nullptr) {
+      monitor_->record_waiting_time(sim.now() - since);
+    }
+  }
+
+  /// Record the current state in the monitor, if any.
+  void observe() {
+    if (monitor_ != nullptr) {
+      monitor_->level.update(sim.now(), static_cast<double>(list_.size()));
+      monitor_->queue_length.update(sim.now(), static_cast<double>(evs.size()));
+    }
+  }
+
+protected:
+  simcpp20::simulation<Time> &sim;
+  /// Pending gets in FIFO order with their predicates. Aborted gets are
+  /// unlinked immediately.
+  wait_queue<simcpp20::value_event<Value, Time>,
+             std::function<bool(const Value &)>>
+      evs{};
+  std::list<Value> list_;
+  simcpp20::monitor<Time> *monitor_ = nullptr;
+};
+
+/**
+ * Used to create a (discrete) shared store for a given type where each value is
+ * stored under a key and a get() only retrieves values with the given key.
+ * Values and waiting gets are indexed by key, so matching a put() with a
+ * waiting get() and vice versa takes constant time. Values and waiting gets
+ * with the same key are served in FIFO order.
+ *
+ * To create a new instance, initialize the class passing
+ * the types of the keys and the stored values.
  *
- *     simcpp20::resource<> resource;
+ *     simcpp20::keyed_store<int, order> store{sim};
  *
+ * @tparam Key Type used for keys. Must be hashable.
+ * @tparam Value Type used for stored values.
  * @tparam Time Type used for simulation time.
  */
-template <class Time = double> class resource {
+template <typename Key, typename Value, typename Time = double>
+class keyed_store {
 public:
-  resource(simcpp20::simulation<Time> &sim, uint64_t available)
-      : sim{sim}, available_{available} {}
+  keyed_store(simcpp20::simulation<Time> &sim) : sim{sim} {}
 
-  simcpp20::event<Time> request() {
+  keyed_store(const keyed_store &) = delete;
+  keyed_store &operator=(const keyed_store &) = delete;
+
+  /**
+   * @tparam Args inferred types of the Value constructor.
+   * @param key key to store the value under.
+   * @param args arguments for the constructor of the Value associated the event.
+   * @return A new triggered event that confirms the effect of the put operation.
+   */
+  template <typename... Args>
+  simcpp20::event<Time> put(const Key &key, Args &&...args) {
     auto ev = sim.event();
-    evs.push(ev);
-    trigger_evs();
+    ev.trigger();
+
+    auto waiters = evs.find(key);
+    if (waiters != evs.end()) {
+      // a get for this key is waiting, so the store holds no value for it.
+      // unlink it before triggering, since a select decided by the trigger may
+      // abort other gets for the key
+      auto getter = waiters->second.pop();
+      --waiting_;
+      if (waiters->second.empty()) {
+        evs.erase(waiters);
+      }
+      getter.trigger(std::forward<Args>(args)...);
+    } else {
+      values_[key].push(std::forward<Args>(args)...);
+      ++size_;
+    }
+
     return ev;
   }
 
-  void release() {
-    ++available_;
-    trigger_evs();
+  /**
+   * @param key key of the value to retrieve.
+   * @return A new value event that could be triggered if there are values available for the key or pending otherwise.
+   */
+  simcpp20::value_event<Value, Time> get(const Key &key) {
+    auto ev = sim.template event<Value>();
+
+    auto values = values_.find(key);
+    if (values != values_.end()) {
+      ev.trigger(std::move(values->second.front()));
+      values->second.pop();
+      --size_;
+      if (values->second.empty()) {
+        values_.erase(values);
+      }
+      return ev;
+    }
+
+    auto [waiters, inserted] = evs.try_emplace(key);
+    if (inserted) {
+      // unlink the key when its last waiting get is aborted
+      waiters->second.set_abort_callback([this, key] {
+        --waiting_;
+        auto it = evs.find(key);
+        if (it->second.empty()) {
+          evs.erase(it);
+        }
+      });
+    }
+    waiters->second.push(ev);
+    ++waiting_;
+    return ev;
   }
 
-  uint64_t available() const { return available_; }
+  /**
+   * @return size_t number of stored elements.
+   */
+  constexpr size_t size() const {
+    return size_;
+  }
+
+  /**
+   * @param key key to count the stored elements for.
+   * @return size_t number of stored elements with the given key.
+   */
+  size_t size(const Key &key) const {
+    auto values = values_.find(key);
+    return values == values_.end() ? 0 : values->second.size();
+  }
 
   /**
    * @return size_t number of waiting events.
    */
   constexpr size_t waiting() const {
-    return evs.size();
+    return waiting_;
   }
 
 protected:
-  std::queue<simcpp20::event<Time>> evs{};
   simcpp20::simulation<Time> &sim;
-  uint64_t available_;
-
-  void trigger_evs() {
-    while (available_ > 0 && evs.size() > 0) {
-      auto ev = evs.front();
-      evs.pop();
-      if (ev.aborted()) {
-        continue;
-      }
-
-      ev.trigger();
-      --available_;
-    }
-  }
+  /// Pending gets by key. Keys without pending gets are removed.
+  std::unordered_map<Key, wait_queue<simcpp20::value_event<Value, Time>>> evs{};
+  /// Stored values by key. Keys without stored values are removed.
+  std::unordered_map<Key, ring_buffer<Value>> values_{};
+  size_t size_ = 0;
+  size_t waiting_ = 0;
 };
 
 /**
- * Used to create a (discrete) shared store for a given type.
+ * Used to create a (discrete) shared store with priority for a given type.
+ * The lower the number the higher the priority.
  *
  * To create a new instance, initialize the class passing
  * the type of the stored values.
  *
- *     simcpp20::resource<int> store;
+ *     simcpp20::resource<int> priority_store;
  *
  * @tparam Value Type used for stored values.
  * @tparam Time Type used for simulation time.
  */
 
-template <typename Value, typename Time = double> class store {
+template <typename Value, typename Time = double> class priority_store {
+  typedef std::tuple<int16_t, Time, id_type> pq_key;
 public:
-  store(simcpp20::simulation<Time> &sim) : sim{sim} {}
+  /**
+   * @param sim Reference to the simulation.
+   * @param capacity maximum number of stored elements. A put() on a full store
+   * waits until a get() frees space.
+   */
+  priority_store(simcpp20::simulation<Time> &sim,
+                 size_t capacity = std::numeric_limits<size_t>::max())
+      : sim{sim}, capacity_{capacity} {
+    assert(capacity_ > 0);
+  }
 
+  priority_store(const priority_store &) = delete;
+  priority_store &operator=(const priority_store &) = delete;
 
   /**
    * @tparam Args inferred types of the Value constructor.
    * @param args arguments for the constructor of the Value associated the event.
-   * @return A new triggered event that confirms the effect of the put operation.
+   * @return A new event that confirms the effect of the put operation. It is
+   * triggered immediately if the store is not full, or once space is freed
+   * otherwise. Waiting puts are served in FIFO order. The event is allocated
+   * and scheduled even if the store is not full; try_put() is the only put
+   * without an event, so use it if the confirmation is not needed.
    */
   template <typename... Args>
   simcpp20::event<Time> put(Args &&...args) {
     auto ev = sim.event();
-    queue_.push(std::forward<Args>(args)...);
-    ev.trigger();
-    trigger_put();
+    if (can_hand_off()) {
+      pop_get().trigger(std::forward<Args>(args)...);
+      ev.trigger();
+    } else if (put_evs.empty() && queue_.size() < capacity_) {
+      queue_.push(std::forward<Args>(args)...);
+      ev.trigger();
+      trigger_waiting();
+    } else {
+      put_evs.push(ev, Value(std::forward<Args>(args)...));
+    }
+    observe();
     return ev;
   }
 
   /**
+   * Put a value without creating a confirmation event, so no event is
+   * allocated and scheduled.
+   *
+   * @tparam Args inferred types of the Value constructor.
+   * @param args arguments for the constructor of the Value.
+   * @return Whether the value was stored. Always true if the store is not full.
+   */
+  template <typename... Args> bool try_put(Args &&...args) {
+    if (can_hand_off()) {
+      pop_get().trigger(std::forward<Args>(args)...);
+      observe();
+      return true;
+    }
+    if (!put_evs.empty() || queue_.size() >= capacity_) {
+      return false;
+    }
+
+    queue_.push(std::forward<Args>(args)...);
+    trigger_waiting();
+    return true;
+  }
+
+  /**
+   * @param priority the priority of the get event (the smaller value the higher priority)
    * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
    */
-  simcpp20::value_event<Value, Time> get() {
+  simcpp20::value_event<Value, Time> get(int16_t priority) {
     auto ev = sim.template event<Value>();
+    // values are only stored while no get is waiting
     if (queue_.size() > 0) {
-      ev.trigger(queue_.front());
+      record_wait(sim.now());
+      ev.trigger(std::move(queue_.front()));
       queue_.pop();
+      trigger_get();
     } else {
-      evs.push(ev);
+      evs.push(ev, pq_key{priority, sim.now(), next_id_});
+      ++next_id_;
     }
+    observe();
     return ev;
   }
 
@@ -120,6 +1823,13 @@ public:
     return queue_.size();
   }
 
+  /**
+   * @return size_t maximum number of stored elements.
+   */
+  constexpr size_t capacity() const {
+    return capacity_;
+  }
+
   /**
    * @return size_t number of waiting events.
    */
@@ -127,41 +1837,118 @@ public:
     return evs.size();
   }
 
+  /**
+   * @return size_t number of waiting put events.
+   */
+  constexpr size_t waiting_puts() const {
+    return put_evs.size();
+  }
+
+  /**
+   * Attach a monitor which records the number of stored elements, the number
+   * of waiting gets and their waiting times from now on.
+   *
+   * @param monitor monitor to record into, or nullptr to detach it. Must
+   * outlive the store or be detached.
+   */
+  void set_monitor(simcpp20::monitor<Time> *monitor) {
+    monitor_ = monitor;
+    if (monitor_ == nullptr) {
+      evs.set_abort_callback(nullptr);
+      return;
+    }
+
+    evs.set_abort_callback([this] { observe(); });
+    observe();
+  }
+
 protected:
-  void trigger_put() {
-    // a put has been made and a number of waiting events could be triggered
-    while (evs.size() > 0 && queue_.size() > 0) {
-      auto ev = evs.front();
-      evs.pop();
-      if (ev.aborted()) {
-        continue;
-      }
-      ev.trigger(queue_.front());
+  /**
+   * @return Whether a value put now can be delivered directly into the value
+   * event of the waiting get with the highest priority, bypassing the queue.
+   */
+  bool can_hand_off() const {
+    return queue_.size() == 0 && !evs.empty();
+  }
+
+  /**
+   * @return Waiting get with the highest priority, removed from the queue
+   * after recording its waiting time.
+   */
+  simcpp20::value_event<Value, Time> pop_get() {
+    record_wait(std::get<1>(evs.front()->key_));
+    return evs.pop();
+  }
+
+  /// @param since simulation time at which the served get was made.
+  void record_wait(Time since) {
+    if (monitor_ != nullptr) {
+      monitor_->record_waiting_time(sim.now() - since);
+    }
+  }
+
+  /// Record the current state in the monitor, if any.
+  void observe() {
+    if (monitor_ != nullptr) {
+      monitor_->level.update(sim.now(), static_cast<double>(queue_.size()));
+      monitor_->queue_length.update(sim.now(), static_cast<double>(evs.size()));
+    }
+  }
+
+  void trigger_waiting() {
+    while (!evs.empty() && queue_.size() > 0) {
+      // leave the store consistent before triggering, since a select decided
+      // by the trigger may abort other gets
+      auto value = std::move(queue_.front());
       queue_.pop();
+      pop_get().trigger(std::move(value));
+      trigger_get();
     }
   }
 
+  void trigger_get() {
+    // a get has been made and a number of waiting puts could be admitted
+    while (!put_evs.empty() && queue_.size() < capacity_) {
+      queue_.push(std::move(put_evs.front()->payload_));
+      put_evs.pop().trigger();
+    }
+  }
 protected:
   simcpp20::simulation<Time> &sim;
-  std::queue<simcpp20::value_event<Value, Time>> evs{};
-  std::queue<Value> queue_;
+  /// Pending gets ordered by priority, get time and sequence. Aborted gets
+  /// are removed immediately.
+  priority_wait_queue<simcpp20::value_event<Value, Time>, pq_key> evs{};
+  /// Pending puts with their values, waiting for space.
+  wait_queue<simcpp20::event<Time>, Value> put_evs{};
+  ring_buffer<Value> queue_;   
+  size_t capacity_;
+  id_type next_id_ = 0;
+  simcpp20::monitor<Time> *monitor_ = nullptr;
 };
 
 /**
- * Used to create a (discrete) shared store for a given type with a filtering get.
+ * Used to create a (discrete) shared store for a given type where the values
+ * are retrieved by their own priority rather than in insertion order. The
+ * stored values are kept in a binary heap, so put() and get() take logarithmic
+ * time. By default, the smallest value has the highest priority. Values with
+ * the same priority are retrieved in insertion order.
  *
  * To create a new instance, initialize the class passing
  * the type of the stored values.
  *
- *     simcpp20::resource<int> filtered_store;
+ *     simcpp20::item_priority_store<std::pair<int, job>> store{sim};
  *
  * @tparam Value Type used for stored values.
  * @tparam Time Type used for simulation time.
+ * @tparam Compare Comparison of values. Returns true if the first value has a
+ * higher priority than the second value.
  */
-
-template <typename Value, typename Time = double> class filtered_store {
+template <typename Value, typename Time = double,
+          typename Compare = std::less<Value>>
+class item_priority_store {
 public:
-  filtered_store(simcpp20::simulation<Time> &sim) : sim{sim} {}
+  item_priority_store(simcpp20::simulation<Time> &sim, Compare compare = {})
+      : sim{sim}, compare_{std::move(compare)} {}
 
   /**
    * @tparam Args inferred types of the Value constructor.
@@ -171,31 +1958,23 @@ public:
   template <typename... Args>
   simcpp20::event<Time> put(Args &&...args) {
     auto ev = sim.event();
-    list_.push_back(std::forward<Args>(args)...);
+    heap_.push_back(item{Value(std::forward<Args>(args)...), next_id_});
+    ++next_id_;
+    std::push_heap(heap_.begin(), heap_.end(), heap_compare());
     ev.trigger();
     trigger_put();
     return ev;
   }
 
   /**
-   * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
-  */
-  simcpp20::value_event<Value, Time> get() {
-    std::function<bool(const Value& v)> p = [](const Value&) { return true; };
-    return get(p);
-  }
-
-
-  /**
-   * @param p a predicate that states the conditions that must hold of retrieving a value.
-   * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
+   * @return A new value event that is triggered with the value with the highest priority if there are values available in the store or pending otherwise.
    */
-  simcpp20::value_event<Value, Time> get(std::function<bool(const Value& v)> p) {
+  simcpp20::value_event<Value, Time> get() {
     auto ev = sim.template event<Value>();
-    if (list_.size() > 0) {
-      trigger_get(ev, p);
+    if (heap_.size() > 0) {
+      ev.trigger(pop());
     } else {
-      evs.push_back({ ev, p });
+      evs.push(ev);
     }
     return ev;
   }
@@ -203,9 +1982,8 @@ public:
   /**
    * @return size_t number of stored elements.
    */
-
   constexpr size_t size() const {
-    return list_.size();
+    return heap_.size();
   }
 
   /**
@@ -216,59 +1994,110 @@ public:
   }
 
 protected:
+  /// One stored value with its insertion sequence number.
+  struct item {
+    Value value_;
+    id_type id_;
+  };
+
   void trigger_put() {
-    // the only value candidate to be checked is the newly added one at the list back
-    // some maintenance: get rid of aborted events, if any
-    evs.erase(std::remove_if(evs.begin(), evs.end(), [](auto pair) { return pair.first.aborted(); }), evs.end());
-    if (evs.size() == 0 || list_.size() == 0)
-      return;
-    for (auto it = evs.begin(); it != evs.end(); ++it) {
-      auto ev = it->first;
-      auto p = it->second;
-      if (p(list_.back())) {
-        ev.trigger(list_.back());
-        it = evs.erase(it);
-        list_.pop_back();
-        break;
-      }        
+    // a put has been made and a number of waiting events could be triggered
+    while (!evs.empty() && heap_.size() > 0) {
+      evs.pop().trigger(pop());
     }
   }
 
-  void trigger_get(simcpp20::value_event<Value, Time>& ev, std::function<bool(const Value& v)> p) {
-    // some maintenance: get rid of aborted events, if any
-    evs.erase(std::remove_if(evs.begin(), evs.end(), [](auto pair) { return pair.first.aborted(); }), evs.end());
-    auto it = std::find_if(list_.begin(), list_.end(), p);
-    if (it != list_.end()) {
-      ev.trigger(*it);
-      it = list_.erase(it);
-    } else {
-      evs.push_back({ ev, p });
-    }
+  /// @return Value with the highest priority, removed from the heap.
+  Value pop() {
+    std::pop_heap(heap_.begin(), heap_.end(), heap_compare());
+    auto value = std::move(heap_.back().value_);
+    heap_.pop_back();
+    return value;
+  }
+
+  /// @return Comparison placing the item with the highest priority on top.
+  auto heap_compare() const {
+    return [this](const item &a, const item &b) {
+      if (compare_(a.value_, b.value_)) {
+        return false;
+      }
+      if (compare_(b.value_, a.value_)) {
+        return true;
+      }
+      return a.id_ > b.id_;
+    };
   }
 
 protected:
   simcpp20::simulation<Time> &sim;
-  std::list<std::pair<simcpp20::value_event<Value, Time>, std::function<bool(const Value&)>>> evs{};
-  std::list<Value> list_;
+  /// Pending gets. Aborted gets are unlinked immediately.
+  wait_queue<simcpp20::value_event<Value, Time>> evs{};
+  /// Stored values as a binary heap.
+  std::vector<item> heap_{};
+  Compare compare_;
+  id_type next_id_ = 0;
 };
 
 /**
- * Used to create a (discrete) shared store with priority for a given type.
- * The lower the number the higher the priority.
+ * Used to create a store which delivers each put value to all current
+ * subscribers. Values are kept once in a shared ring buffer, and each
+ * subscriber reads them through its own cursor, so a put neither copies the
+ * value per subscriber nor queues it per subscriber. A value is dropped once
+ * all subscribers read it.
  *
- * To create a new instance, initialize the class passing
- * the type of the stored values.
+ * To create a new instance, initialize the class passing the simulation:
  *
- *     simcpp20::resource<int> priority_store;
+ *     simcpp20::broadcast_store<state> updates{sim};
+ *     auto subscriber = updates.subscribe();
+ *     auto update = co_await updates.get(subscriber);
  *
  * @tparam Value Type used for stored values.
  * @tparam Time Type used for simulation time.
  */
-
-template <typename Value, typename Time = double> class priority_store {
-  typedef std::tuple<int16_t, Time, simcpp20::value_event<Value, Time>> pq_item; 
+template <typename Value, typename Time = double> class broadcast_store {
 public:
-  priority_store(simcpp20::simulation<Time> &sim) : sim{sim} {}
+  /// Type of the delivered values, shared by all subscribers.
+  typedef std::shared_ptr<const Value> value_type;
+
+  broadcast_store(simcpp20::simulation<Time> &sim) : sim{sim} {}
+
+  broadcast_store(const broadcast_store &) = delete;
+  broadcast_store &operator=(const broadcast_store &) = delete;
+
+  /**
+   * @return id_type id of a new subscriber, which receives all values put from
+   * now on.
+   */
+  id_type subscribe() {
+    auto id = next_id_;
+    ++next_id_;
+    subs_.try_emplace(id, first_ + log_.size());
+    return id;
+  }
+
+  /**
+   * Remove a subscriber. Its pending gets are aborted and the values it did
+   * not read yet are released.
+   *
+   * @param id id of the subscriber.
+   */
+  void unsubscribe(id_type id) {
+    auto it = subs_.find(id);
+    if (it == subs_.end()) {
+      return;
+    }
+
+    for (auto seq = it->second.cursor_; seq < first_ + log_.size(); ++seq) {
+      --log_[seq - first_].remaining_;
+    }
+    trim();
+
+    auto evs = std::move(it->second.evs_);
+    subs_.erase(it);
+    while (!evs.empty()) {
+      evs.pop().abort();
+    }
+  }
 
   /**
    * @tparam Args inferred types of the Value constructor.
@@ -278,61 +2107,103 @@ public:
   template <typename... Args>
   simcpp20::event<Time> put(Args &&...args) {
     auto ev = sim.event();
-    queue_.push(std::forward<Args>(args)...);
     ev.trigger();
-    trigger_waiting();
+
+    if (subs_.empty()) {
+      return ev;
+    }
+
+    auto value = std::make_shared<const Value>(std::forward<Args>(args)...);
+    std::uint64_t remaining = 0;
+    for (auto &[id, sub] : subs_) {
+      if (!sub.evs_.empty()) {
+        // a waiting subscriber has read everything, so it reads this value now
+        ++sub.cursor_;
+        sub.evs_.pop().trigger(value);
+      } else {
+        ++remaining;
+      }
+    }
+
+    if (remaining > 0) {
+      log_.push(item{std::move(value), remaining});
+    } else {
+      ++first_;
+    }
     return ev;
   }
 
   /**
-   * @param priority the priority of the get event (the smaller value the higher priority)
-   * @return A new value event that could be triggered if there are values available in the queue or pending otherwise.
+   * @param id id of the subscriber.
+   * @return A new value event that is triggered with the next value the
+   * subscriber did not read yet, once there is one.
    */
-  simcpp20::value_event<Value, Time> get(int16_t priority) {
-    auto ev = sim.template event<Value>();
-    auto item = pq_item{ priority, sim.now(), ev };
-    static auto comparator = std::greater<pq_item>{};
-    // current get is on an empty waiting queue or has a higher priority than all those in the queue
-    if (queue_.size() > 0 && (evs.size() == 0 || comparator(item, evs.top()))) {
-      ev.trigger(queue_.front());
-      queue_.pop();
+  simcpp20::value_event<value_type, Time> get(id_type id) {
+    auto ev = sim.template event<value_type>();
+    auto &sub = subs_.at(id);
+
+    if (sub.evs_.empty() && sub.cursor_ < first_ + log_.size()) {
+      auto &it = log_[sub.cursor_ - first_];
+      ev.trigger(it.value_);
+      --it.remaining_;
+      ++sub.cursor_;
+      trim();
     } else {
-      evs.push(item);
-      trigger_waiting();
+      sub.evs_.push(ev);
     }
     return ev;
   }
 
   /**
-   * @return size_t number of stored elements.
+   * @return size_t number of values not read by all subscribers yet.
    */
+  size_t size() const { return log_.size(); }
 
-  constexpr size_t size() const {
-    return queue_.size();
+  /**
+   * @param id id of the subscriber.
+   * @return size_t number of values the subscriber did not read yet.
+   */
+  size_t size(id_type id) const {
+    return static_cast<size_t>(first_ + log_.size() - subs_.at(id).cursor_);
   }
 
   /**
-   * @return size_t number of waiting events.
+   * @return size_t number of subscribers.
    */
-  constexpr size_t waiting() const {
-    return evs.size();
-  }
+  size_t subscribers() const { return subs_.size(); }
 
 protected:
-  void trigger_waiting() {
-    while (evs.size() > 0 && queue_.size() > 0) {
-      auto ev = std::get<2>(evs.top());
-      evs.pop();
-      if (ev.aborted())
-        continue;
-      ev.trigger(queue_.front());
-      queue_.pop();      
+  /// One stored value with the number of subscribers which did not read it.
+  struct item {
+    value_type value_;
+    std::uint64_t remaining_;
+  };
+
+  /// One subscriber.
+  struct subscriber {
+    explicit subscriber(std::uint64_t cursor) : cursor_{cursor} {}
+
+    /// Sequence number of the next value to read.
+    std::uint64_t cursor_;
+    /// Pending gets. Aborted gets are unlinked immediately.
+    wait_queue<simcpp20::value_event<value_type, Time>> evs_{};
+  };
+
+  /// Drop the values at the front which were read by all subscribers.
+  void trim() {
+    while (!log_.empty() && log_.front().remaining_ == 0) {
+      log_.pop();
+      ++first_;
     }
   }
-protected:
+
   simcpp20::simulation<Time> &sim;
-  std::priority_queue<pq_item, std::vector<pq_item>, std::greater<pq_item>> evs{};
-  std::queue<Value> queue_;   
+  /// Values not read by all subscribers yet.
+  ring_buffer<item> log_{};
+  /// Sequence number of the first value in the log.
+  std::uint64_t first_ = 0;
+  std::unordered_map<id_type, subscriber> subs_{};
+  id_type next_id_ = 0;
 };
 
-} // namespace simcpp20
\ No newline at end of file
+} // namespace simcpp20
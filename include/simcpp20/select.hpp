@@ -0,0 +1,234 @@
+// Copyright © 2021 Felix Schütz.
+// Licensed under the MIT license. See the LICENSE file for details.
+
+#pragma once
+
+#include <concepts>    // std::invocable
+#include <cstddef>     // std::size_t
+#include <functional>  // std::function
+#include <memory>      // std::make_unique, std::unique_ptr
+#include <optional>    // std::optional
+#include <type_traits> // std::decay_t, std::is_base_of_v
+#include <utility>     // std::forward, std::move
+#include <vector>      // std::vector
+
+#include "simcpp20/simcpp20.hpp"
+
+namespace simcpp20 {
+
+/**
+ * Result of select.
+ *
+ * @tparam Value Type of the values of the value events selected from.
+ */
+template <typename Value> struct selection {
+  /// Index of the first ready event among the arguments of select.
+  std::size_t index;
+
+  /// Value of the first ready event, or empty if it has no value.
+  std::optional<Value> value;
+};
+
+/**
+ * State of one select, alive until the select is decided or its event is
+ * aborted. Created by select only.
+ *
+ * @tparam Value Type of the values of the value events selected from.
+ * @tparam Time Type used for simulation time.
+ */
+template <typename Value, typename Time> class select_state final : abort_hook {
+public:
+  /// One event selected from.
+  class branch final : public trigger_hook {
+  public:
+    /**
+     * @param state Select the event belongs to.
+     * @param index Index of the event among the arguments of select.
+     * @param ev Event.
+     * @param value Function taking the value out of the event, if it has one.
+     */
+    branch(select_state &state, std::size_t index, simcpp20::event<Time> ev,
+           std::function<std::optional<Value>()> value)
+        : ev_{std::move(ev)}, value_{std::move(value)}, state_{&state},
+          index_{index} {}
+
+    /// Decide on this event, since it is the first one which is ready.
+    void on_trigger() override { state_->decide(index_); }
+
+    /// Event.
+    simcpp20::event<Time> ev_;
+
+    /// Function taking the value out of the event, if it has one.
+    std::function<std::optional<Value>()> value_;
+
+  private:
+    select_state *state_;
+    std::size_t index_;
+  };
+
+  /**
+   * @param sim Simulation.
+   */
+  explicit select_state(simcpp20::simulation<Time> &sim)
+      : ev_{sim.template event<selection<Value>>()} {}
+
+  /**
+   * Add the next event to select from, unless the select is already decided.
+   *
+   * @tparam Branch Event, value event, or function returning one of them.
+   * Functions are only called while no earlier event is ready, so a get from a
+   * store is only made if it is needed.
+   * @param arg Event or function.
+   * @return bool whether the select is still undecided.
+   */
+  template <typename Branch> bool add(Branch &&arg) {
+    if constexpr (std::invocable<Branch &>) {
+      return add(arg());
+    } else {
+      using event_type = std::decay_t<Branch>;
+      std::function<std::optional<Value>()> value{};
+      if constexpr (!std::is_same_v<event_type, simcpp20::event<Time>>) {
+        static_assert(
+            std::is_base_of_v<value_event<Value, Time>, event_type>,
+            "select only supports events and value events of one type");
+        value = [ev = arg]() -> std::optional<Value> {
+          return std::move(ev.value());
+        };
+      }
+
+      auto index = branches_.size();
+      branches_.push_back(
+          std::make_unique<branch>(*this, index, arg, std::move(value)));
+      auto &b = *branches_.back();
+      if (b.ev_.triggered()) {
+        decide(index);
+      } else if (b.ev_.pending()) {
+        b.ev_.add_trigger_hook(&b);
+      }
+      return !decided_;
+    }
+  }
+
+  /**
+   * Hand ownership of the state to the select event, or delete the state if
+   * the select was already decided.
+   *
+   * @return value_event<selection<Value>, Time> select event.
+   */
+  value_event<selection<Value>, Time> release() {
+    auto ev = ev_;
+    if (decided_) {
+      delete this;
+    } else {
+      owned_ = true;
+      ev.set_abort_hook(this);
+    }
+    return ev;
+  }
+
+  /// Withdraw all events selected from when the select event is aborted.
+  void on_abort() override {
+    withdraw(branches_.size());
+    delete this;
+  }
+
+private:
+  /// Select event.
+  value_event<selection<Value>, Time> ev_;
+
+  /// Events selected from.
+  std::vector<std::unique_ptr<branch>> branches_{};
+
+  /// Whether an event was decided on.
+  bool decided_ = false;
+
+  /// Whether the select event owns the state.
+  bool owned_ = false;
+
+  /**
+   * Trigger the select event with the given event and withdraw the others. If
+   * the event failed, fail the select event with its exception instead.
+   *
+   * @param index Index of the first ready event.
+   */
+  void decide(std::size_t index) {
+    decided_ = true;
+    withdraw(index);
+
+    auto &b = *branches_[index];
+    ev_.set_abort_hook(nullptr);
+    if (auto exception = b.ev_.exception()) {
+      // a failed process has no value, so the select fails in its place
+      b.ev_.defuse();
+      ev_.fail(std::move(exception));
+    } else {
+      std::optional<Value> value{};
+      if (b.value_) {
+        value = b.value_();
+      }
+      ev_.trigger(selection<Value>{index, std::move(value)});
+    }
+
+    if (owned_) {
+      delete this;
+    }
+  }
+
+  /**
+   * Stop observing all events, and withdraw the other queued waits, unlinking
+   * them from their queues so no store hands them a value. Events which other
+   * coroutines await or which are not queued waits, such as processes, are
+   * kept.
+   *
+   * @param keep Index of the event to keep.
+   */
+  void withdraw(std::size_t keep) {
+    // withdrawing an event may wake other waiters, so detach all hooks first
+    for (auto &b : branches_) {
+      b->ev_.remove_trigger_hook(b.get());
+    }
+    for (std::size_t i = 0; i < branches_.size(); ++i) {
+      if (i != keep) {
+        branches_[i]->ev_.withdraw();
+      }
+    }
+  }
+};
+
+/**
+ * Wait for the first of several events to become ready, and withdraw the
+ * others. Pending gets from stores are withdrawn by aborting them, which
+ * removes them from the queue of their store before they receive a value, so
+ * no value is lost and no getter is left behind. Other events, such as
+ * processes, timeouts or gets another process awaits as well, are kept.
+ *
+ * Pass gets as functions, so a store is only asked for a value if no earlier
+ * argument is ready:
+ *
+ *     auto [index, value] = co_await simcpp20::select<int>(
+ *         sim, [&] { return a.get(); }, [&] { return b.get(); },
+ *         sim.timeout(5));
+ *
+ * Aborting the returned event withdraws the queued waits selected from. If the
+ * first ready event is a process which exited with an exception, the returned
+ * event fails with that exception, so awaiting it rethrows it.
+ *
+ * @tparam Value Type of the values of the value events selected from.
+ * @tparam Time Type used for simulation time.
+ * @tparam Branches Events, value events of Value, or functions returning one
+ * of them.
+ * @param sim Simulation.
+ * @param branches Events to select from, in the order of their priority if
+ * several are ready at once.
+ * @return value_event<selection<Value>, Time> event which is triggered with
+ * the index and value of the first ready event.
+ */
+template <typename Value, typename Time, typename... Branches>
+value_event<selection<Value>, Time> select(simcpp20::simulation<Time> &sim,
+                                           Branches &&...branches) {
+  auto state = new select_state<Value, Time>{sim};
+  (state->add(std::forward<Branches>(branches)) && ...);
+  return state->release();
+}
+
+} // namespace simcpp20
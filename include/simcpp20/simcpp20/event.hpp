@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <any>        // std::any
 #include <cassert>    // assert
 #include <cmath>      // std::log2
 #ifndef CLANG_COMPILER
@@ -11,9 +12,12 @@
 #include <experimental/coroutine>
 #endif
 #include <cstddef>    // std::size_t
+#include <exception>  // std::exception, std::exception_ptr
 #include <functional> // std::function
 #include <functional> // std::hash
-#include <utility>    // std::exchange
+#include <optional>   // std::optional
+#include <type_traits> // std::is_same_v, std::remove_reference_t
+#include <utility>    // std::exchange, std::move
 #include <vector>     // std::vector
 
 #ifdef CLANG_COMPILER
@@ -25,6 +29,108 @@ namespace std {
 
 namespace simcpp20 {
 template <typename Time> class simulation;
+template <typename Time> class event;
+
+/**
+ * Base class of wait queue entries holding a pending event. The entry is
+ * notified when the event is aborted, so it can unlink itself immediately.
+ */
+class abort_hook {
+public:
+  /// Called when the event associated with the entry is aborted.
+  virtual void on_abort() = 0;
+
+protected:
+  /// Destructor.
+  ~abort_hook() = default;
+};
+
+/**
+ * Base class of observers notified as soon as a pending event is triggered,
+ * before it is processed. Scheduled events which are processed without being
+ * triggered first, such as timeouts, notify the observer when processed. An
+ * event may have several observers, which are notified in the order they were
+ * added.
+ */
+class trigger_hook {
+public:
+  /// Called when the event associated with the observer becomes ready.
+  virtual void on_trigger() = 0;
+
+protected:
+  /// Destructor.
+  ~trigger_hook() = default;
+
+private:
+  /// Next observer of the same event.
+  trigger_hook *next_ = nullptr;
+
+  template <typename> friend class event;
+};
+
+/// Thrown by co_await in a process which was interrupted.
+class interrupted : public std::exception {
+public:
+  /**
+   * Constructor.
+   *
+   * @param cause Cause passed to event::interrupt.
+   */
+  explicit interrupted(std::any cause) : cause_{std::move(cause)} {}
+
+  /// @return Cause passed to event::interrupt.
+  const std::any &cause() const { return cause_; }
+
+  /// @return Description of the exception.
+  const char *what() const noexcept override { return "process interrupted"; }
+
+private:
+  /// Cause passed to event::interrupt.
+  std::any cause_;
+};
+
+/// Outcome of awaiting an event with event::checked.
+enum class await_status {
+  /// The event was processed.
+  processed,
+
+  /// The event or the awaiting process was aborted.
+  aborted,
+
+  /// The awaiting process was interrupted.
+  interrupted,
+
+  /// The event belongs to a process which exited with an exception.
+  failed
+};
+
+/**
+ * Result of awaiting an event with event::checked. Converts to true if the
+ * event was processed.
+ */
+struct await_result {
+  /// Outcome of awaiting the event.
+  await_status status = await_status::processed;
+
+  /// Cause passed to event::interrupt, if interrupted.
+  std::any cause = {};
+
+  /// Exception the process of the event exited with, if failed.
+  std::exception_ptr exception = nullptr;
+
+  /// @return Whether the event was processed.
+  explicit operator bool() const { return status == await_status::processed; }
+};
+
+/**
+ * Result of awaiting a value event with value_event::checked.
+ *
+ * @tparam Value Type of the value.
+ */
+template <typename Value> struct value_await_result : await_result {
+  /// Value moved out of the event, if the event was processed.
+  std::optional<Value> value = {};
+};
 
 /**
  * One event.
@@ -33,6 +139,9 @@ template <typename Time> class simulation;
  */
 template <typename Time = double> class event {
 public:
+  /// Type used for simulation time.
+  using time_type = Time;
+
   /**
    * Constructor.
    *
@@ -109,14 +218,14 @@ public:
 
     data_->sim_.schedule(*this);
     data_->state_ = state::triggered;
+    notify_trigger_hooks();
   }
 
   /**
    * Set the event state to aborted. If the event is not pending, nothing is
-   * done.
-   *
-   * TODO(fschuetz04): Check whether used on a process? Destroy process
-   * coroutine?
+   * done. Coroutines awaiting the event are destroyed, unless they await it
+   * with checked(). If the event is associated with a process, the process is
+   * only unwound once it is resumed. Use cancel() to stop it immediately.
    */
   void abort() const {
     assert(awaiting_ev_ == nullptr);
@@ -128,15 +237,56 @@ public:
 
     data_->state_ = state::aborted;
 
-    for (auto &handle : data_->handles_) {
-      handle.destroy();
+    if (data_->hook_ != nullptr) {
+      std::exchange(data_->hook_, nullptr)->on_abort();
+    }
+
+    for (auto &waiter : data_->handles_) {
+      // handles of interrupted processes are cleared
+      if (!waiter.handle_) {
+        continue;
+      }
+
+      if (waiter.proc_ != nullptr && waiter.proc_->checked_) {
+        // resume the process, which awaits the event with checked()
+        data_->use_count_ += 1;
+        waiter.proc_->restored_ = true;
+        waiter.proc_->reroute(data_->sim_);
+      } else {
+        waiter.handle_.destroy();
+      }
     }
     data_->handles_.clear();
 
     data_->cbs_.clear();
   }
 
-  /// @param cb Callback to be called when the event is processed.
+  /**
+   * Trigger the event with an exception instead of a value. Processes awaiting
+   * the event rethrow the exception, and checked awaits report it as failed. If
+   * nothing awaits the event when it is processed and the exception was not
+   * defused, the simulation rethrows it from step(), run() and run_until(). If
+   * the event is not pending, nothing is done.
+   *
+   * @param exception Exception to fail the event with.
+   */
+  void fail(std::exception_ptr exception) const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+    assert(exception != nullptr);
+
+    if (!pending()) {
+      return;
+    }
+
+    data_->exception_ = std::move(exception);
+    trigger();
+  }
+
+  /**
+   * @param cb Callback to be called when the event is processed. A callback
+   * does not handle the exception of a failed event, unless it defuses it.
+   */
   void add_callback(std::function<void(const event<Time> &)> cb) const {
     assert(awaiting_ev_ == nullptr);
     assert(data_ != nullptr);
@@ -148,6 +298,49 @@ public:
     data_->cbs_.emplace_back(cb);
   }
 
+  /**
+   * @param hook Hook to notify when the event is aborted, or nullptr to remove
+   * the current hook. Used by wait queues to unlink aborted events.
+   */
+  void set_abort_hook(abort_hook *hook) const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+    data_->hook_ = hook;
+  }
+
+  /**
+   * @param hook Hook to notify when the event is triggered, after all hooks
+   * added before. Used by select to decide on the first ready event.
+   */
+  void add_trigger_hook(trigger_hook *hook) const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+    assert(hook != nullptr && hook->next_ == nullptr);
+
+    auto *slot = &data_->trigger_hook_;
+    while (*slot != nullptr) {
+      slot = &(*slot)->next_;
+    }
+    *slot = hook;
+  }
+
+  /**
+   * @param hook Hook to no longer notify when the event is triggered. If the
+   * hook was not added, nothing is done.
+   */
+  void remove_trigger_hook(trigger_hook *hook) const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+
+    for (auto *slot = &data_->trigger_hook_; *slot != nullptr;
+         slot = &(*slot)->next_) {
+      if (*slot == hook) {
+        *slot = std::exchange(hook->next_, nullptr);
+        return;
+      }
+    }
+  }
+
   /// @return Whether the event is pending.
   bool pending() const {
     assert(awaiting_ev_ == nullptr);
@@ -176,6 +369,23 @@ public:
     return data_->state_ == state::aborted;
   }
 
+  /// @return Exception the event failed with, or nullptr.
+  std::exception_ptr exception() const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+    return data_->exception_;
+  }
+
+  /**
+   * Mark the exception of the event as handled, so the simulation does not
+   * rethrow it if nothing awaits the event.
+   */
+  void defuse() const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+    data_->defused_ = true;
+  }
+
   /**
    * Called when using co_await on the event. The calling coroutine is only
    * suspended if this method returns false.
@@ -195,18 +405,31 @@ public:
    * @param handle Corotuine handle.
    */
   template <typename Promise>
-  void await_suspend(std::coroutine_handle<Promise> handle) {
+  bool await_suspend(std::coroutine_handle<Promise> handle) {
     assert(awaiting_ev_ == nullptr);
     assert(data_ != nullptr);
 
     if (aborted()) {
       handle.destroy();
-      return;
+      return true;
+    }
+
+    auto proc = static_cast<event &>(handle.promise().ev_).data_->proc_;
+    if (proc->started_ && proc->cause_) {
+      // deliver a pending interrupt without suspending
+      proc->restored_ = true;
+      awaiting_ev_ = &handle.promise().ev_;
+      return false;
     }
 
-    data_->handles_.push_back(handle);
+    proc->awaited_ = data_;
+    proc->index_ = data_->handles_.size();
+    proc->handle_ = handle;
+    proc->awaiter_ = this;
+    data_->handles_.push_back({handle, proc});
     decrement_use_count();
     awaiting_ev_ = &handle.promise().ev_;
+    return true;
   }
 
   /**
@@ -214,20 +437,251 @@ public:
    * the coroutine did not need to be suspended.
    */
   void await_resume() {
+    auto result = resume();
+    switch (result.status) {
+    case await_status::aborted:
+      // unwind the coroutine of the aborted process
+      throw nullptr;
+    case await_status::interrupted:
+      throw interrupted{std::move(result.cause)};
+    case await_status::failed:
+      std::rethrow_exception(result.exception);
+    default:
+      break;
+    }
+  }
+
+  /**
+   * Awaitable returned by checked().
+   *
+   * @tparam Event Type of the awaited event, event or value_event.
+   */
+  template <typename Event> class checked_awaitable {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param ev Event to await.
+     */
+    explicit checked_awaitable(const Event &ev) : ev_{ev} {}
+
+    /// @return Whether the event is processed or aborted.
+    bool await_ready() const { return ev_.processed() || ev_.aborted(); }
+
+    /**
+     * @tparam Promise Promise type of the coroutine.
+     * @param handle Coroutine handle.
+     * @return Whether the coroutine is suspended.
+     */
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> handle) {
+      auto proc = static_cast<event &>(handle.promise().ev_).data_->proc_;
+      proc->checked_ = true;
+      return ev_.await_suspend(handle);
+    }
+
+    /**
+     * @return Result of awaiting the event. For value events, it holds the
+     * value moved out of the event if the event was processed.
+     */
+    auto await_resume() {
+      if constexpr (std::is_same_v<Event, event>) {
+        return ev_.resume();
+      } else {
+        using value_type = std::remove_reference_t<decltype(ev_.value())>;
+        value_await_result<value_type> result{ev_.resume()};
+        if (result) {
+          result.value = std::move(ev_.value());
+        }
+        return result;
+      }
+    }
+
+  private:
+    /// Event to await.
+    Event ev_;
+  };
+
+  /**
+   * Await the event without exceptions. co_await on the returned awaitable
+   * does not throw, but returns an await_result. If the event is aborted, the
+   * process is resumed with await_status::aborted instead of being destroyed.
+   * Interrupts and exceptions of awaited processes are returned as well.
+   *
+   *     auto result = co_await sim.timeout(5).checked();
+   *     if (!result) {
+   *       co_return;
+   *     }
+   *
+   * See value_event::checked for events with values.
+   *
+   * @return Awaitable returning the result of awaiting the event.
+   */
+  checked_awaitable<event> checked() const {
+    assert(awaiting_ev_ == nullptr);
     assert(data_ != nullptr);
+    return checked_awaitable<event>{*this};
+  }
 
-    if (awaiting_ev_ == nullptr) {
+  /**
+   * Interrupt the process associated with this event. The process is resumed
+   * at the current simulation time, and the co_await it is suspended in throws
+   * interrupted with the given cause. The event it awaited stays as it is, but
+   * no longer resumes the process. If the process is not suspended, the
+   * interrupt is delivered at its next suspension. If the process finished or
+   * already has an interrupt pending, nothing is done.
+   *
+   * @param cause Cause of the interrupt.
+   */
+  void interrupt(std::any cause = {}) const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+
+    auto proc = data_->proc_;
+    if (proc == nullptr || proc->cause_) {
       return;
     }
 
-    data_->use_count_ += 1;
+    proc->cause_ = std::move(cause);
+    if (!proc->started_ || proc->awaited_ == nullptr || proc->restored_) {
+      return;
+    }
+
+    // unlink the process from the awaited event in O(1) and keep the event
+    // alive until the process is resumed
+    auto awaited = proc->awaited_;
+    awaited->handles_[proc->index_].handle_ = nullptr;
+    awaited->use_count_ += 1;
+    proc->restored_ = true;
+    proc->reroute(data_->sim_);
+  }
+
+  /**
+   * Cancel the process associated with the event. The coroutine frame is
+   * destroyed immediately, which releases its local variables, the process is
+   * unlinked from the event it awaits, and the event is aborted. If the event
+   * is not associated with a suspended process, this is equivalent to abort().
+   *
+   * If the process was the last one awaiting a queued event, such as a get
+   * from a store or a request of a resource, that event is aborted as well,
+   * which withdraws it from its queue. This includes queued events awaited
+   * through any_of or all_of, such as req | sim.timeout(5). Other events the
+   * process awaits are kept, since other processes may await them.
+   *
+   * Must not be called by the process on its own event.
+   */
+  void cancel() const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+
+    if (auto proc = data_->proc_) {
+      // a process without an awaited event is running
+      assert(proc->awaited_ != nullptr);
+
+      // keep the awaited event alive while the frame is destroyed
+      event awaited{proc->awaiter_->data_};
+      auto slot = std::exchange(proc->awaited_, nullptr);
+      slot->handles_[proc->index_].handle_ = nullptr;
+      if (proc->restored_) {
+        // the use count of the awaited event was restored by an interrupt or
+        // checked abort, so release it with the frame
+        proc->awaiter_->awaiting_ev_ = nullptr;
+      }
+      proc->handle_.destroy();
+
+      // withdraw a queued wait nothing awaits any more, so it does not take a
+      // value or unit meant for other processes
+      awaited.withdraw();
+    }
+
+    abort();
+  }
+
+  /**
+   * Abort the event if it is a pending queued wait, such as a get from a store
+   * or a request of a resource, which no coroutine awaits. This removes it
+   * from its queue. Events of any_of and all_of count as queued waits, and
+   * withdraw their own queued events when aborted. Other events are kept,
+   * since other processes or callbacks may still depend on them.
+   */
+  void withdraw() const {
+    assert(awaiting_ev_ == nullptr);
+    assert(data_ != nullptr);
+
+    if (pending() && data_->hook_ != nullptr && !has_waiters()) {
+      abort();
+    }
+  }
+
+protected:
+  /// Notify and remove all trigger hooks, in the order they were added.
+  void notify_trigger_hooks() const {
+    // unlink each hook before notifying it, so it may remove other hooks
+    while (auto hook = data_->trigger_hook_) {
+      data_->trigger_hook_ = std::exchange(hook->next_, nullptr);
+      hook->on_trigger();
+    }
+  }
+
+  /// @return Whether a coroutine awaits the event.
+  bool has_waiters() const {
+    for (auto &waiter : data_->handles_) {
+      if (waiter.handle_) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Called when a coroutine is resumed after using co_await on the event or if
+   * the coroutine did not need to be suspended.
+   *
+   * @return Result of awaiting the event.
+   */
+  await_result resume() {
+    assert(data_ != nullptr);
+
+    if (awaiting_ev_ == nullptr) {
+      return result();
+    }
+
+    auto proc = awaiting_ev_->data_->proc_;
+    if (!std::exchange(proc->restored_, false)) {
+      data_->use_count_ += 1;
+    }
     auto awaiting_ev = std::exchange(awaiting_ev_, nullptr);
+    proc->awaited_ = nullptr;
+    proc->checked_ = false;
 
     if (awaiting_ev->aborted()) {
-      throw nullptr;
+      return {await_status::aborted};
+    }
+
+    if (!proc->started_) {
+      // resumed from the initial suspension, interrupts are delivered later
+      proc->started_ = true;
+    } else if (proc->cause_) {
+      auto cause = std::move(*proc->cause_);
+      proc->cause_.reset();
+      return {await_status::interrupted, std::move(cause)};
     }
+    return result();
   }
 
+  /// @return Result of awaiting the event, given it is not pending.
+  await_result result() const {
+    if (aborted()) {
+      return {await_status::aborted};
+    }
+    if (data_->exception_) {
+      return {await_status::failed, {}, data_->exception_};
+    }
+    return {};
+  }
+
+public:
+
   /**
    * Alias for simulation::any_of.
    *
@@ -263,6 +717,77 @@ public:
     return data_ == other.data_;
   }
 
+protected:
+  class data;
+
+  /// State of a process, used to interrupt or cancel it. Owned by its promise.
+  class process_state {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param data Shared data of the event associated with the process.
+     */
+    explicit process_state(data *data) : data_{data} { data_->proc_ = this; }
+
+    process_state(const process_state &) = delete;
+    process_state &operator=(const process_state &) = delete;
+
+    /// Destructor.
+    ~process_state() { data_->proc_ = nullptr; }
+
+    /// Shared data of the event the process is suspended on, if any.
+    data *awaited_ = nullptr;
+
+    /// Index of the handle of the process in the handles of that event.
+    std::size_t index_ = 0;
+
+    /// Handle of the process.
+    std::coroutine_handle<> handle_ = {};
+
+    /// Event in the coroutine frame used to await that event.
+    event *awaiter_ = nullptr;
+
+    /// Whether the process was resumed from its initial suspension.
+    bool started_ = false;
+
+    /// Whether the use count of the awaited event was already restored.
+    bool restored_ = false;
+
+    /// Whether the process awaits an event with checked().
+    bool checked_ = false;
+
+    /// Cause of a pending interrupt, if any.
+    std::optional<std::any> cause_ = {};
+
+    /**
+     * Resume the suspended process at the current simulation time, regardless
+     * of the event it awaits.
+     *
+     * @param sim Reference to the simulation.
+     */
+    void reroute(simulation<Time> &sim) {
+      auto ev = sim.timeout(Time{0});
+      awaited_ = ev.data_;
+      index_ = 0;
+      ev.data_->handles_.push_back({handle_, this});
+    }
+
+  private:
+    /// Shared data of the event associated with the process.
+    data *data_;
+  };
+
+  /// Coroutine awaiting an event.
+  struct waiter {
+    /// Handle of the coroutine, or nullptr if it was unlinked.
+    std::coroutine_handle<> handle_;
+
+    /// State of the process the coroutine belongs to.
+    process_state *proc_;
+  };
+
+public:
   /// Promise type for a coroutine returning an event.
   class promise_type {
   public:
@@ -324,8 +849,18 @@ public:
      */
     event<Time> initial_suspend() const { return sim_.timeout(Time{0}); }
 
-    /// Called when an exception is thrown inside the coroutine and not handled.
-    void unhandled_exception() const { assert(false); }
+    /**
+     * Called when an exception is thrown inside the coroutine and not handled.
+     * The event associated with the coroutine is failed with the exception.
+     * Nothing is done if the coroutine is unwound because its event was
+     * aborted.
+     */
+    void unhandled_exception() const {
+      if (ev_.aborted()) {
+        return;
+      }
+      ev_.fail(std::current_exception());
+    }
 
     /**
      * Called when the coroutine returns. Trigger the event associated with the
@@ -348,12 +883,16 @@ public:
      * coroutine returns.
      */
     event<Time> ev_;
+
+    /// State used to interrupt or cancel the coroutine.
+    process_state proc_{ev_.data_};
   };
 
 protected:
   /**
    * Set the event state to processed, resume all coroutines awaiting this
-   * event, and call all callbacks added to the event.
+   * event, and call all callbacks added to the event. Rethrow the exception of
+   * a failed event if nothing awaits it and it was not defused.
    */
   void process() const {
     assert(awaiting_ev_ == nullptr);
@@ -364,9 +903,16 @@ protected:
     }
 
     data_->state_ = state::processed;
-
-    for (auto &handle : data_->handles_) {
-      handle.resume();
+    notify_trigger_hooks();
+
+    // a callback alone does not handle a failure, unless it defuses it
+    bool handled = false;
+    for (std::size_t i = 0; i < data_->handles_.size(); ++i) {
+      // handles of interrupted processes are cleared
+      if (auto handle = data_->handles_[i].handle_) {
+        handled = true;
+        handle.resume();
+      }
     }
     data_->handles_.clear();
 
@@ -374,6 +920,11 @@ protected:
       cb(*this);
     }
     data_->cbs_.clear();
+
+    if (data_->exception_ && !handled && !data_->defused_) {
+      // like an uncaught exception, an exception nobody awaits ends the run
+      std::rethrow_exception(data_->exception_);
+    }
   }
 
   /**
@@ -419,9 +970,9 @@ protected:
 
     /// Destructor.
     virtual ~data() {
-      for (auto &handle : handles_) {
-        if (handle)
-          handle.destroy();
+      for (auto &waiter : handles_) {
+        if (waiter.handle_)
+          waiter.handle_.destroy();
       }
     }
 
@@ -431,12 +982,27 @@ protected:
     /// State of the event.
     state state_ = state::pending;
 
-    /// Handles of coroutines awaiting the event.
-    std::vector<std::coroutine_handle<>> handles_ = {};
+    /// Coroutines awaiting the event.
+    std::vector<waiter> handles_ = {};
 
     /// Callbacks added to the event.
     std::vector<std::function<void(const event<Time> &)>> cbs_ = {};
 
+    /// Wait queue entry to notify when the event is aborted, if any.
+    abort_hook *hook_ = nullptr;
+
+    /// First observer to notify when the event is triggered, if any.
+    trigger_hook *trigger_hook_ = nullptr;
+
+    /// State of the process associated with the event, if any.
+    process_state *proc_ = nullptr;
+
+    /// Exception the event failed with, if any.
+    std::exception_ptr exception_ = nullptr;
+
+    /// Whether the exception is handled even if nothing awaits the event.
+    bool defused_ = false;
+
     /// Reference to the simulation.
     simulation<Time> &sim_;
   };
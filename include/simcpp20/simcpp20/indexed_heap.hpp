@@ -0,0 +1,131 @@
+// Copyright © 2021 Felix Schütz.
+// Licensed under the MIT license. See the LICENSE file for details.
+
+#pragma once
+
+#include <cassert> // assert
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+#include <vector>  // std::vector
+
+namespace simcpp20 {
+/**
+ * Binary min-heap over the items 0, ..., n - 1, each with a key which can be
+ * changed in O(log n). Ties are broken by the smaller item.
+ *
+ * @tparam Key Type of the keys.
+ */
+template <typename Key> class indexed_heap {
+public:
+  /**
+   * Constructor.
+   *
+   * @param keys Initial keys of the items.
+   */
+  explicit indexed_heap(std::vector<Key> keys = {})
+      : keys_{std::move(keys)}, heap_(keys_.size()), pos_(keys_.size()) {
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+      heap_[i] = i;
+      pos_[i] = i;
+    }
+    for (std::size_t i = heap_.size() / 2; i-- > 0;) {
+      sift_down(i);
+    }
+  }
+
+  /// @return Item with the smallest key.
+  std::size_t top() const {
+    assert(!heap_.empty());
+    return heap_.front();
+  }
+
+  /**
+   * @param item Item.
+   * @return Key of the item.
+   */
+  const Key &key(std::size_t item) const { return keys_[item]; }
+
+  /**
+   * Change the key of an item.
+   *
+   * @param item Item.
+   * @param key New key of the item.
+   */
+  void update(std::size_t item, Key key) {
+    keys_[item] = std::move(key);
+    sift_down(pos_[item]);
+    sift_up(pos_[item]);
+  }
+
+  /// @return Number of items.
+  std::size_t size() const { return heap_.size(); }
+
+private:
+  /**
+   * @param a Item.
+   * @param b Item.
+   * @return Whether item a comes before item b.
+   */
+  bool less(std::size_t a, std::size_t b) const {
+    if (keys_[a] < keys_[b]) {
+      return true;
+    }
+    if (keys_[b] < keys_[a]) {
+      return false;
+    }
+    return a < b;
+  }
+
+  /**
+   * @param pos Position in the heap.
+   * @param item Item to place at the given position.
+   */
+  void place(std::size_t pos, std::size_t item) {
+    heap_[pos] = item;
+    pos_[item] = pos;
+  }
+
+  /// @param pos Position of the item to move up to its place.
+  void sift_up(std::size_t pos) {
+    auto item = heap_[pos];
+    while (pos > 0) {
+      auto parent = (pos - 1) / 2;
+      if (!less(item, heap_[parent])) {
+        break;
+      }
+      place(pos, heap_[parent]);
+      pos = parent;
+    }
+    place(pos, item);
+  }
+
+  /// @param pos Position of the item to move down to its place.
+  void sift_down(std::size_t pos) {
+    auto item = heap_[pos];
+    while (true) {
+      auto child = 2 * pos + 1;
+      if (child >= heap_.size()) {
+        break;
+      }
+      if (child + 1 < heap_.size() && less(heap_[child + 1], heap_[child])) {
+        ++child;
+      }
+      if (!less(heap_[child], item)) {
+        break;
+      }
+      place(pos, heap_[child]);
+      pos = child;
+    }
+    place(pos, item);
+  }
+
+  /// Keys of the items.
+  std::vector<Key> keys_;
+
+  /// Items ordered as a binary min-heap by key.
+  std::vector<std::size_t> heap_;
+
+  /// Position of each item in the heap.
+  std::vector<std::size_t> pos_;
+};
+} // namespace simcpp20
@@ -0,0 +1,134 @@
+// Copyright © 2021 Felix Schütz.
+// Licensed under the MIT license. See the LICENSE file for details.
+
+#pragma once
+
+#include <cassert> // assert
+#include <cstddef> // std::size_t
+#include <memory>  // std::allocator, std::construct_at, std::destroy_at
+#include <utility> // std::exchange, std::forward, std::move
+
+namespace simcpp20 {
+/**
+ * FIFO queue of values stored in a contiguous, growable ring buffer. Values
+ * are moved in and out, so move-only types are supported.
+ *
+ * @tparam Value Type of the stored values.
+ */
+template <typename Value> class ring_buffer {
+public:
+  /// Constructor.
+  ring_buffer() = default;
+
+  ring_buffer(const ring_buffer &) = delete;
+  ring_buffer &operator=(const ring_buffer &) = delete;
+
+  /**
+   * Move constructor.
+   *
+   * @param other Ring buffer to move.
+   */
+  ring_buffer(ring_buffer &&other) noexcept
+      : buf_{std::exchange(other.buf_, nullptr)},
+        capacity_{std::exchange(other.capacity_, 0)},
+        head_{std::exchange(other.head_, 0)},
+        size_{std::exchange(other.size_, 0)} {}
+
+  /// Destructor.
+  ~ring_buffer() {
+    while (!empty()) {
+      pop();
+    }
+    std::allocator<Value>{}.deallocate(buf_, capacity_);
+  }
+
+  /**
+   * Construct a value at the back of the queue.
+   *
+   * @tparam Args Types of arguments to construct the value with.
+   * @param args Arguments to construct the value with.
+   */
+  template <typename... Args> void push(Args &&...args) {
+    if (size_ == capacity_) {
+      grow();
+    }
+
+    std::construct_at(buf_ + index(size_), std::forward<Args>(args)...);
+    ++size_;
+  }
+
+  /// @return First value of the queue.
+  Value &front() {
+    assert(!empty());
+    return buf_[head_];
+  }
+
+  /// @return First value of the queue.
+  const Value &front() const {
+    assert(!empty());
+    return buf_[head_];
+  }
+
+  /**
+   * @param offset Offset from the first value. Must be less than the size.
+   * @return Value at the given offset.
+   */
+  Value &operator[](std::size_t offset) {
+    assert(offset < size_);
+    return buf_[index(offset)];
+  }
+
+  /// Remove the first value of the queue.
+  void pop() {
+    assert(!empty());
+
+    std::destroy_at(buf_ + head_);
+    head_ = index(1);
+    --size_;
+  }
+
+  /// @return Whether the queue is empty.
+  bool empty() const { return size_ == 0; }
+
+  /// @return Number of stored values.
+  std::size_t size() const { return size_; }
+
+private:
+  /**
+   * @param offset Offset from the first value.
+   * @return Index of the value in the buffer.
+   */
+  std::size_t index(std::size_t offset) const {
+    return (head_ + offset) & (capacity_ - 1);
+  }
+
+  /// Double the capacity of the buffer, moving the stored values.
+  void grow() {
+    std::size_t capacity = capacity_ == 0 ? 8 : 2 * capacity_;
+    auto buf = std::allocator<Value>{}.allocate(capacity);
+
+    for (std::size_t i = 0; i < size_; ++i) {
+      auto value = buf_ + index(i);
+      std::construct_at(buf + i, std::move(*value));
+      std::destroy_at(value);
+    }
+
+    std::allocator<Value>{}.deallocate(buf_, capacity_);
+    buf_ = buf;
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  /// Storage of the values. The capacity is always a power of two.
+  Value *buf_ = nullptr;
+
+  /// Number of values the storage can hold.
+  std::size_t capacity_ = 0;
+
+  /// Index of the first value.
+  std::size_t head_ = 0;
+
+  /// Number of stored values.
+  std::size_t size_ = 0;
+};
+} // namespace simcpp20
@@ -6,10 +6,12 @@
 #include <cassert>    // assert
 #include <cstddef>    // std::size_t
 #include <cstdint>    // std::uint64_t
+#include <exception>  // std::exception_ptr
 #include <functional> // std::greater
-#include <memory>     // std::make_shared, std::make_unique
+#include <memory>     // std::enable_shared_from_this, std::make_shared,
+                      // std::shared_ptr
 #include <queue>      // std::priority_queue
-#include <utility>    // std::forward
+#include <utility>    // std::exchange, std::forward, std::move
 #include <vector>     // std::vector
 #include <concepts>   // std::same_as
 
@@ -74,7 +76,10 @@ public:
   /**
    * @param evs Vector of events.
    * @return New pending event which is triggered when any of the given events
-   * is processed.
+   * is processed. If that event failed, the new event fails with its exception
+   * instead, which counts as handling the failed event. Aborting the new event,
+   * for example by cancelling the last process awaiting it, withdraws the
+   * given events which are queued waits, see event::withdraw.
    */
   event_type any_of(std::vector<event_type> evs) {
     if (evs.size() == 0) {
@@ -83,18 +88,15 @@ public:
 
     for (const auto &ev : evs) {
       if (ev.processed()) {
-        return timeout(0);
+        return settled(ev.exception());
       }
     }
 
-    auto any_of_ev = event();
-
-    for (const auto &ev : evs) {
-      ev.add_callback(
-          [any_of_ev](const auto &) mutable { any_of_ev.trigger(); });
-    }
-
-    return any_of_ev;
+    return compose(evs, 0, [](composite &state, const event_type &done) {
+      if (!fail_with(state.ev_, done)) {
+        state.ev_.trigger();
+      }
+    });
   }
 
   /**
@@ -110,13 +112,19 @@ public:
   /**
    * @param evs Vector of events.
    * @return New pending event which is triggered when all of the given events
-   * are processed.
+   * are processed. If one of them failed, the new event fails with the first
+   * such exception instead, which counts as handling the failed event. Aborting
+   * the new event withdraws the given events which are queued waits, as for
+   * any_of.
    */
   event_type all_of(std::vector<event_type> evs) {
     size_t n = evs.size();
 
     for (const auto &ev : evs) {
       if (ev.processed()) {
+        if (auto exception = ev.exception()) {
+          return settled(std::move(exception));
+        }
         --n;
       }
     }
@@ -125,19 +133,15 @@ public:
       return timeout(0);
     }
 
-    auto all_of_ev = event();
-    auto n_ptr = std::make_shared<std::size_t>(n);
-
-    for (const auto &ev : evs) {
-      ev.add_callback([all_of_ev, n_ptr](const auto &) mutable {
-        --*n_ptr;
-        if (*n_ptr == 0) {
-          all_of_ev.trigger();
-        }
-      });
-    }
-
-    return all_of_ev;
+    return compose(evs, n, [](composite &state, const event_type &done) {
+      if (fail_with(state.ev_, done)) {
+        return;
+      }
+      --state.n_;
+      if (state.n_ == 0) {
+        state.ev_.trigger();
+      }
+    });
   }
 
   /**
@@ -161,7 +165,11 @@ public:
     ++next_id_;
   }
 
-  /// Process the next scheduled event.
+  /**
+   * Process the next scheduled event. If the event failed with an exception
+   * and nothing awaits it, the exception is rethrown, for example if a process
+   * nobody awaits exits with an exception.
+   */
   void step() {
     auto sev = scheduled_evs_.top();
     scheduled_evs_.pop();
@@ -203,6 +211,145 @@ public:
   Time peek() const { return scheduled_evs_.size() > 0 ? scheduled_evs_.top().time_ : std::numeric_limits<Time>::infinity(); }
 
 private:
+  /**
+   * Shared state of the callbacks of any_of or all_of. Registered as the abort
+   * hook of its event, so aborting that event withdraws the queued waits among
+   * its events.
+   */
+  class composite final : public abort_hook,
+                          public std::enable_shared_from_this<composite> {
+  public:
+    /**
+     * @param ev Event of any_of or all_of.
+     * @param n Number of events all_of still waits for.
+     */
+    composite(event_type ev, std::size_t n) : ev_{std::move(ev)}, n_{n} {}
+
+    composite(const composite &) = delete;
+    composite &operator=(const composite &) = delete;
+
+    /// Destructor. Unregisters the state if its event is still pending.
+    ~composite() {
+      if (ev_.pending()) {
+        ev_.set_abort_hook(nullptr);
+      }
+    }
+
+    /// Withdraw the queued waits among the events, see event::withdraw.
+    void on_abort() override {
+      // withdrawing an event destroys its callback, which may hold the state
+      auto self = this->shared_from_this();
+      for (auto &wait : waits_) {
+        if (auto data = std::exchange(wait, nullptr)) {
+          event_type{data}.withdraw();
+        }
+      }
+    }
+
+    /// Event of any_of or all_of.
+    event_type ev_;
+
+    /// Number of events all_of still waits for.
+    std::size_t n_;
+
+    /**
+     * Shared data of the events which were queued waits when added, or
+     * nullptr for other events and events whose callback was destroyed.
+     */
+    std::vector<typename event_type::data *> waits_{};
+  };
+
+  /// Held by the callback on one event of any_of or all_of.
+  class composite_link {
+  public:
+    /**
+     * @param state Shared state.
+     * @param wait Shared data of the event if it is a queued wait, or nullptr.
+     */
+    composite_link(std::shared_ptr<composite> state,
+                   typename event_type::data *wait)
+        : state_{std::move(state)}, index_{state_->waits_.size()} {
+      state_->waits_.push_back(wait);
+    }
+
+    composite_link(const composite_link &) = delete;
+    composite_link &operator=(const composite_link &) = delete;
+
+    /// Destructor. Forgets the event, whose data may be freed afterwards.
+    ~composite_link() { state_->waits_[index_] = nullptr; }
+
+    /// Shared state.
+    std::shared_ptr<composite> state_;
+
+  private:
+    std::size_t index_;
+  };
+
+  /**
+   * Create the event of any_of or all_of.
+   *
+   * @param evs Events to wait for.
+   * @param n Number of events all_of waits for.
+   * @param cb Function called with the shared state whenever one of the events
+   * is processed.
+   * @return New pending event.
+   */
+  template <typename Callback>
+  event_type compose(const std::vector<event_type> &evs, std::size_t n,
+                     Callback cb) {
+    auto state = std::make_shared<composite>(event(), n);
+    state->ev_.set_abort_hook(state.get());
+
+    for (const auto &ev : evs) {
+      if (ev.processed() || ev.aborted()) {
+        continue;
+      }
+
+      auto wait = ev.data_->hook_ != nullptr ? ev.data_ : nullptr;
+      auto link = std::make_shared<composite_link>(state, wait);
+      ev.add_callback(
+          [link, cb](const auto &done) { cb(*link->state_, done); });
+    }
+
+    return state->ev_;
+  }
+
+  /**
+   * @param exception Exception to fail the new event with, or nullptr.
+   * @return New event which is processed immediately, failed with the given
+   * exception if any.
+   */
+  event_type settled(std::exception_ptr exception) {
+    if (exception == nullptr) {
+      return timeout(0);
+    }
+
+    auto ev = event();
+    ev.fail(std::move(exception));
+    return ev;
+  }
+
+  /**
+   * Fail a pending event of any_of or all_of with the exception of one of its
+   * events, which is defused since the exception is passed on.
+   *
+   * @param composite Event of any_of or all_of.
+   * @param ev Processed event.
+   * @return Whether the processed event failed.
+   */
+  static bool fail_with(const event_type &composite, const event_type &ev) {
+    auto exception = ev.exception();
+    if (exception == nullptr) {
+      return false;
+    }
+
+    if (composite.pending()) {
+      ev.defuse();
+      composite.fail(std::move(exception));
+    }
+    return true;
+  }
+
   /// One event scheduled to be processed.
   class scheduled_event {
   public:
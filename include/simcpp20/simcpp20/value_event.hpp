@@ -4,12 +4,14 @@
 #pragma once
 
 #include <cassert>   // assert
+#include <exception> // std::current_exception
 #ifndef CLANG_COMPILER
 #include <coroutine>  // std::suspend_never
 #else
 #include <experimental/coroutine>
 #endif
-#include <utility>   // std::forward, std::exchange
+#include <optional>  // std::optional
+#include <utility>   // std::forward
 
 #ifdef CLANG_COMPILER
 namespace std {
@@ -59,7 +61,8 @@ public:
   /**
    * Called when a coroutine is resumed after using co_await on the event or if
    * the coroutine did not need to be suspended. The return value is the return
-   * value of the co_await expression.
+   * value of the co_await expression. Use std::move on it to take a move-only
+   * value out of the event.
    *
    * @return Value of the event.
    */
@@ -70,6 +73,26 @@ public:
     return value();
   }
 
+  /**
+   * Await the event without exceptions, like event::checked. The result holds
+   * the value of the event if it was processed. The value is moved out of the
+   * event, so no other process should read it.
+   *
+   *     auto result = co_await store.get().checked();
+   *     if (!result) {
+   *       co_return;
+   *     }
+   *     use(*result.value);
+   *
+   * @return Awaitable returning the value or the status of awaiting the event.
+   */
+  typename event<Time>::template checked_awaitable<value_event>
+  checked() const {
+    assert(event<Time>::awaiting_ev_ == nullptr);
+    assert(event<Time>::data_ != nullptr);
+    return typename event<Time>::template checked_awaitable<value_event>{*this};
+  }
+
   /// @return Value of the event.
   Value &value() const {
     assert(event<Time>::awaiting_ev_ == nullptr);
@@ -140,8 +163,18 @@ public:
      */
     event<Time> initial_suspend() const { return sim_.timeout(Time{0}); }
 
-    /// Called when an exception is thrown inside the coroutine and not handled.
-    void unhandled_exception() const { assert(false); }
+    /**
+     * Called when an exception is thrown inside the coroutine and not handled.
+     * The event associated with the coroutine is failed with the exception and
+     * has no value. Nothing is done if the coroutine is unwound because its
+     * event was aborted.
+     */
+    void unhandled_exception() const {
+      if (ev_.aborted()) {
+        return;
+      }
+      ev_.fail(std::current_exception());
+    }
 
     /**
      * Called when the coroutine returns. Trigger the event associated with the
@@ -169,6 +202,9 @@ public:
      * the coroutine returns with the value the coroutine returns.
      */
     value_event<Value, Time> ev_;
+
+    /// State used to interrupt or cancel the coroutine.
+    typename event<Time>::process_state proc_{ev_.data_};
   };
 
 private:
@@ -177,15 +213,8 @@ private:
   public:
     using event<Time>::data::data;
 
-    /// Destructor.
-    ~data() override {
-      if (value_ != nullptr) {
-        delete std::exchange(value_, nullptr);
-      }
-    }
-
-    /// Value of the event.
-    Value *value_ = nullptr;
+    /// Value of the event, stored inline to avoid a separate allocation.
+    std::optional<Value> value_{};
   };
 
   /**
@@ -194,7 +223,7 @@ private:
    */
   template <typename... Args> void set_value(Args &&...args) const {
     auto casted_data = static_cast<data *>(event<Time>::data_);
-    casted_data->value_ = new Value(std::forward<Args>(args)...);
+    casted_data->value_.emplace(std::forward<Args>(args)...);
   }
 
   friend class simulation<Time>;
@@ -0,0 +1,523 @@
+// Copyright © 2021 Felix Schütz.
+// Licensed under the MIT license. See the LICENSE file for details.
+
+#pragma once
+
+#include <cassert> // assert
+#include <cstddef>    // std::size_t
+#include <functional> // std::function, std::less
+#include <new>        // operator new, operator delete
+#include <tuple>      // std::tuple
+#include <type_traits> // std::is_invocable_v, std::is_null_pointer_v
+#include <utility>    // std::exchange, std::move, std::swap
+#include <vector>     // std::vector
+
+#include "event.hpp"
+
+namespace simcpp20 {
+/**
+ * @tparam Payload Type of the payloads of a queue.
+ * @tparam Callback Type of the callback.
+ * @param cb Callback taking the payload of an aborted entry, taking no
+ * arguments, or nullptr.
+ * @return Callback taking the payload of an aborted entry, or an empty
+ * function.
+ */
+template <typename Payload, typename Callback>
+std::function<void(const Payload &)> wrap_abort_callback(Callback cb) {
+  if constexpr (std::is_null_pointer_v<Callback>) {
+    return nullptr;
+  } else if constexpr (std::is_invocable_v<Callback &, const Payload &>) {
+    return cb;
+  } else {
+    return [cb = std::move(cb)](const Payload &) { cb(); };
+  }
+}
+
+/**
+ * Free list of storage for the entries of a queue. Storage of removed entries
+ * is reused, so a queue only allocates while it grows beyond its largest size
+ * so far.
+ *
+ * @tparam Entry Type of the entries.
+ */
+template <typename Entry> class entry_pool {
+public:
+  /// Constructor.
+  entry_pool() = default;
+
+  entry_pool(const entry_pool &) = delete;
+  entry_pool &operator=(const entry_pool &) = delete;
+
+  /**
+   * Move constructor.
+   *
+   * @param other Pool to move.
+   */
+  entry_pool(entry_pool &&other) noexcept
+      : free_{std::exchange(other.free_, nullptr)} {}
+
+  /// Destructor. Frees the unused storage.
+  ~entry_pool() {
+    while (free_ != nullptr) {
+      ::operator delete(std::exchange(free_, free_->next_));
+    }
+  }
+
+  /**
+   * @tparam Args Types of the arguments of the constructor of the entry.
+   * @param args Arguments of the constructor of the entry.
+   * @return New entry, constructed in reused storage if possible.
+   */
+  template <typename... Args> Entry *create(Args &&...args) {
+    void *storage = nullptr;
+    if (free_ != nullptr) {
+      storage = std::exchange(free_, free_->next_);
+    } else {
+      storage = ::operator new(sizeof(Entry));
+    }
+
+    try {
+      return new (storage) Entry(std::forward<Args>(args)...);
+    } catch (...) {
+      release(storage);
+      throw;
+    }
+  }
+
+  /**
+   * Destroy an entry and keep its storage for the next one.
+   *
+   * @param e Entry created by this pool.
+   */
+  void destroy(Entry *e) {
+    e->~Entry();
+    release(e);
+  }
+
+private:
+  /// Unused storage, linked into the free list.
+  struct node {
+    node *next_;
+  };
+
+  static_assert(sizeof(Entry) >= sizeof(node));
+
+  /// First unused storage, or nullptr if there is none.
+  node *free_ = nullptr;
+
+  /// @param storage Unused storage to add to the free list.
+  void release(void *storage) { free_ = new (storage) node{free_}; }
+};
+
+/**
+ * FIFO queue of pending events, implemented as a doubly linked list of
+ * entries. Aborting a queued event unlinks its entry immediately, so the
+ * queue never holds aborted events and its size is always exact. The storage
+ * of removed entries is reused for new ones.
+ *
+ * @tparam Event Type of the queued events.
+ * @tparam Payload Type of additional data stored with each event.
+ */
+template <typename Event, typename Payload = std::tuple<>> class wait_queue {
+public:
+  /// One entry of the queue.
+  class entry final : public abort_hook {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param queue Queue the entry belongs to.
+     * @param ev Queued event.
+     * @param payload Additional data stored with the event.
+     */
+    entry(wait_queue &queue, Event ev, Payload payload)
+        : ev_{std::move(ev)}, payload_{std::move(payload)}, queue_{&queue} {}
+
+    /// Unlink the entry from its queue when the event is aborted.
+    void on_abort() override {
+      auto queue = queue_;
+      if (!queue->abort_cb_) {
+        queue->erase(this);
+        return;
+      }
+
+      auto payload = std::move(payload_);
+      queue->erase(this);
+      // the callback may destroy the queue, so call a copy of it
+      auto cb = queue->abort_cb_;
+      cb(payload);
+    }
+
+    /// @return Next entry in the queue, or nullptr if this is the last one.
+    entry *next() const { return next_; }
+
+    /// Queued event.
+    Event ev_;
+
+    /// Additional data stored with the event.
+    Payload payload_;
+
+    /// Simulation time at which the event was queued, if set by the owner.
+    typename Event::time_type since_{};
+
+  private:
+    /// Queue the entry belongs to.
+    wait_queue *queue_;
+
+    /// Previous entry in the queue.
+    entry *prev_ = nullptr;
+
+    /// Next entry in the queue.
+    entry *next_ = nullptr;
+
+    friend class wait_queue;
+  };
+
+  /// Constructor.
+  wait_queue() = default;
+
+  wait_queue(const wait_queue &) = delete;
+  wait_queue &operator=(const wait_queue &) = delete;
+
+  /**
+   * Move constructor.
+   *
+   * @param other Queue to move.
+   */
+  wait_queue(wait_queue &&other) noexcept
+      : pool_{std::move(other.pool_)}, abort_cb_{std::move(other.abort_cb_)},
+        head_{std::exchange(other.head_, nullptr)},
+        tail_{std::exchange(other.tail_, nullptr)},
+        size_{std::exchange(other.size_, 0)} {
+    for (auto e = head_; e != nullptr; e = e->next_) {
+      e->queue_ = this;
+    }
+  }
+
+  /// Destructor. Unlinks all remaining entries.
+  ~wait_queue() {
+    while (!empty()) {
+      erase(head_);
+    }
+  }
+
+  /**
+   * Append an event to the queue.
+   *
+   * @param ev Pending event.
+   * @param payload Additional data stored with the event.
+   * @return Entry of the event.
+   */
+  entry *push(Event ev, Payload payload = {}) {
+    assert(ev.pending());
+
+    auto e = pool_.create(*this, std::move(ev), std::move(payload));
+    e->prev_ = tail_;
+    if (tail_ != nullptr) {
+      tail_->next_ = e;
+    } else {
+      head_ = e;
+    }
+    tail_ = e;
+    ++size_;
+
+    e->ev_.set_abort_hook(e);
+    return e;
+  }
+
+  /// @return First entry of the queue, or nullptr if the queue is empty.
+  entry *front() const { return head_; }
+
+  /**
+   * Remove the first entry of the queue.
+   *
+   * @return Event of the removed entry.
+   */
+  Event pop() {
+    assert(head_ != nullptr);
+
+    auto ev = head_->ev_;
+    erase(head_);
+    return ev;
+  }
+
+  /**
+   * Unlink an entry from the queue and delete it.
+   *
+   * @param e Entry of this queue.
+   */
+  void erase(entry *e) {
+    assert(e != nullptr && e->queue_ == this);
+
+    if (e->prev_ != nullptr) {
+      e->prev_->next_ = e->next_;
+    } else {
+      head_ = e->next_;
+    }
+    if (e->next_ != nullptr) {
+      e->next_->prev_ = e->prev_;
+    } else {
+      tail_ = e->prev_;
+    }
+    --size_;
+
+    e->ev_.set_abort_hook(nullptr);
+    pool_.destroy(e);
+  }
+
+  /// @return Whether the queue is empty.
+  bool empty() const { return size_ == 0; }
+
+  /// @return Number of queued events.
+  std::size_t size() const { return size_; }
+
+  /**
+   * @tparam Callback Type of the callback.
+   * @param cb Callback to be called after an aborted event was unlinked, with
+   * or without the payload of its entry, or nullptr. Used by owners whose
+   * other waiters may be unblocked by the removal, or which keep totals over
+   * the payloads.
+   */
+  template <typename Callback> void set_abort_callback(Callback cb) {
+    abort_cb_ = wrap_abort_callback<Payload>(std::move(cb));
+  }
+
+private:
+  /// Storage of the entries.
+  entry_pool<entry> pool_{};
+
+  /// Callback called after an aborted event was unlinked.
+  std::function<void(const Payload &)> abort_cb_{};
+
+  /// First entry of the queue.
+  entry *head_ = nullptr;
+
+  /// Last entry of the queue.
+  entry *tail_ = nullptr;
+
+  /// Number of entries in the queue.
+  std::size_t size_ = 0;
+};
+
+/**
+ * Priority queue of pending events, implemented as a binary heap of entries.
+ * Each entry tracks its position in the heap, so aborting a queued event
+ * removes its entry immediately without searching for it. The storage of
+ * removed entries is reused for new ones.
+ *
+ * @tparam Event Type of the queued events.
+ * @tparam Key Type of the keys ordering the events. The event with the
+ * smallest key is at the front of the queue.
+ * @tparam Payload Type of additional data stored with each event.
+ */
+template <typename Event, typename Key, typename Payload = std::tuple<>>
+class priority_wait_queue {
+public:
+  /// One entry of the queue.
+  class entry final : public abort_hook {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param queue Queue the entry belongs to.
+     * @param ev Queued event.
+     * @param key Key ordering the event.
+     * @param payload Additional data stored with the event.
+     */
+    entry(priority_wait_queue &queue, Event ev, Key key, Payload payload)
+        : ev_{std::move(ev)}, key_{std::move(key)},
+          payload_{std::move(payload)}, queue_{&queue} {}
+
+    /// Remove the entry from its queue when the event is aborted.
+    void on_abort() override {
+      auto queue = queue_;
+      if (!queue->abort_cb_) {
+        queue->erase(this);
+        return;
+      }
+
+      auto payload = std::move(payload_);
+      queue->erase(this);
+      // the callback may destroy the queue, so call a copy of it
+      auto cb = queue->abort_cb_;
+      cb(payload);
+    }
+
+    /// Queued event.
+    Event ev_;
+
+    /// Key ordering the event.
+    Key key_;
+
+    /// Additional data stored with the event.
+    Payload payload_;
+
+  private:
+    /// Queue the entry belongs to.
+    priority_wait_queue *queue_;
+
+    /// Position of the entry in the heap.
+    std::size_t pos_ = 0;
+
+    friend class priority_wait_queue;
+  };
+
+  /// Constructor.
+  priority_wait_queue() = default;
+
+  priority_wait_queue(const priority_wait_queue &) = delete;
+  priority_wait_queue &operator=(const priority_wait_queue &) = delete;
+
+  /**
+   * Move constructor.
+   *
+   * @param other Queue to move.
+   */
+  priority_wait_queue(priority_wait_queue &&other) noexcept
+      : pool_{std::move(other.pool_)}, abort_cb_{std::move(other.abort_cb_)},
+        heap_{std::move(other.heap_)} {
+    other.heap_.clear();
+    for (auto e : heap_) {
+      e->queue_ = this;
+    }
+  }
+
+  /// Destructor. Removes all remaining entries.
+  ~priority_wait_queue() {
+    while (!empty()) {
+      erase(heap_.back());
+    }
+  }
+
+  /**
+   * Insert an event into the queue.
+   *
+   * @param ev Pending event.
+   * @param key Key ordering the event.
+   * @param payload Additional data stored with the event.
+   * @return Entry of the event.
+   */
+  entry *push(Event ev, Key key, Payload payload = {}) {
+    assert(ev.pending());
+
+    auto e = pool_.create(*this, std::move(ev), std::move(key),
+                          std::move(payload));
+    e->pos_ = heap_.size();
+    heap_.push_back(e);
+    sift_up(e->pos_);
+
+    e->ev_.set_abort_hook(e);
+    return e;
+  }
+
+  /// @return Entry with the smallest key, or nullptr if the queue is empty.
+  entry *front() const { return empty() ? nullptr : heap_.front(); }
+
+  /**
+   * Remove the entry with the smallest key.
+   *
+   * @return Event of the removed entry.
+   */
+  Event pop() {
+    assert(!empty());
+
+    auto ev = heap_.front()->ev_;
+    erase(heap_.front());
+    return ev;
+  }
+
+  /**
+   * Remove an entry from the queue and delete it.
+   *
+   * @param e Entry of this queue.
+   */
+  void erase(entry *e) {
+    assert(e != nullptr && e->queue_ == this);
+
+    auto pos = e->pos_;
+    auto last = heap_.back();
+    heap_.pop_back();
+    if (last != e) {
+      place(pos, last);
+      sift_down(pos);
+      sift_up(last->pos_);
+    }
+
+    e->ev_.set_abort_hook(nullptr);
+    pool_.destroy(e);
+  }
+
+  /// @return Whether the queue is empty.
+  bool empty() const { return heap_.empty(); }
+
+  /// @return Number of queued events.
+  std::size_t size() const { return heap_.size(); }
+
+  /// @return Entries of the queue in heap order.
+  const std::vector<entry *> &entries() const { return heap_; }
+
+  /**
+   * @tparam Callback Type of the callback.
+   * @param cb Callback to be called after an aborted event was removed, with
+   * or without the payload of its entry, or nullptr.
+   */
+  template <typename Callback> void set_abort_callback(Callback cb) {
+    abort_cb_ = wrap_abort_callback<Payload>(std::move(cb));
+  }
+
+private:
+  /**
+   * @param pos Position in the heap.
+   * @param e Entry to place at the given position.
+   */
+  void place(std::size_t pos, entry *e) {
+    heap_[pos] = e;
+    e->pos_ = pos;
+  }
+
+  /// @param pos Position of the entry to move up to its place.
+  void sift_up(std::size_t pos) {
+    auto e = heap_[pos];
+    while (pos > 0) {
+      auto parent = (pos - 1) / 2;
+      if (!std::less<Key>{}(e->key_, heap_[parent]->key_)) {
+        break;
+      }
+      place(pos, heap_[parent]);
+      pos = parent;
+    }
+    place(pos, e);
+  }
+
+  /// @param pos Position of the entry to move down to its place.
+  void sift_down(std::size_t pos) {
+    auto e = heap_[pos];
+    while (true) {
+      auto child = 2 * pos + 1;
+      if (child >= heap_.size()) {
+        break;
+      }
+      if (child + 1 < heap_.size() &&
+          std::less<Key>{}(heap_[child + 1]->key_, heap_[child]->key_)) {
+        ++child;
+      }
+      if (!std::less<Key>{}(heap_[child]->key_, e->key_)) {
+        break;
+      }
+      place(pos, heap_[child]);
+      pos = child;
+    }
+    place(pos, e);
+  }
+
+  /// Storage of the entries.
+  entry_pool<entry> pool_{};
+
+  /// Callback called after an aborted event was removed.
+  std::function<void(const Payload &)> abort_cb_{};
+
+  /// Entries ordered as a binary min-heap by key.
+  std::vector<entry *> heap_{};
+};
+} // namespace simcpp20
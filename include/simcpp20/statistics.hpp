@@ -0,0 +1,473 @@
+// Copyright © 2021 Felix Schütz.
+// Licensed under the MIT license. See the LICENSE file for details.
+
+#pragma once
+
+#include <algorithm>  // std::max, std::min, std::sort
+#include <array>      // std::array
+#include <cassert>    // assert
+#include <cmath>      // std::frexp, std::ldexp, std::sqrt
+#include <cstddef>    // std::size_t
+#include <cstdint>    // std::uint64_t
+#include <functional> // std::function
+#include <limits>     // std::numeric_limits
+#include <vector>     // std::vector
+
+namespace simcpp20 {
+
+/**
+ * Running statistics of a series of samples, such as waiting times. Uses
+ * Welford's algorithm, so recording a sample takes constant time and memory.
+ *
+ * @tparam Value Type of the samples.
+ */
+template <typename Value = double> class tally {
+public:
+  /**
+   * @param x sample to record.
+   */
+  void record(Value x) {
+    auto v = static_cast<double>(x);
+    ++count_;
+    auto delta = v - mean_;
+    mean_ += delta / static_cast<double>(count_);
+    m2_ += delta * (v - mean_);
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+  }
+
+  /**
+   * @return std::uint64_t number of recorded samples.
+   */
+  std::uint64_t count() const { return count_; }
+
+  /**
+   * @return double mean of the samples, or 0 if there are none.
+   */
+  double mean() const { return mean_; }
+
+  /**
+   * @return double sample variance, or 0 if there are less than two samples.
+   */
+  double variance() const {
+    return count_ < 2 ? 0 : m2_ / static_cast<double>(count_ - 1);
+  }
+
+  /**
+   * @return double sample standard deviation.
+   */
+  double stddev() const { return std::sqrt(variance()); }
+
+  /**
+   * @return double smallest sample, or infinity if there are none.
+   */
+  double min() const { return min_; }
+
+  /**
+   * @return double largest sample, or -infinity if there are none.
+   */
+  double max() const { return max_; }
+
+private:
+  std::uint64_t count_ = 0;
+  double mean_ = 0;
+  /// Sum of squared differences from the mean.
+  double m2_ = 0;
+  double min_ = std::numeric_limits<double>::infinity();
+  double max_ = -std::numeric_limits<double>::infinity();
+};
+
+/**
+ * Histogram of non-negative samples with logarithmically sized buckets, each
+ * split into linearly sized sub-buckets, similar to an HDR histogram. The
+ * relative error of a reported quantile is bounded by 1 / sub_buckets. All
+ * buckets are allocated on construction, so recording a sample takes constant
+ * time and never allocates.
+ */
+class log_histogram {
+public:
+  /**
+   * @param min_exponent samples below 2^min_exponent are counted as zero.
+   * @param max_exponent samples at or above 2^max_exponent are counted in the
+   * last bucket.
+   * @param sub_buckets number of linear sub-buckets per power of two.
+   */
+  explicit log_histogram(int min_exponent = -20, int max_exponent = 44,
+                         std::size_t sub_buckets = 64)
+      : min_exponent_{min_exponent}, sub_buckets_{sub_buckets},
+        counts_(1 + static_cast<std::size_t>(max_exponent - min_exponent) *
+                        sub_buckets,
+                0) {
+    assert(max_exponent > min_exponent && sub_buckets > 0);
+  }
+
+  /**
+   * @param x sample to record. Negative samples are counted as zero.
+   */
+  void record(double x) {
+    ++counts_[index(x)];
+    ++count_;
+  }
+
+  /**
+   * @return std::uint64_t number of recorded samples.
+   */
+  std::uint64_t count() const { return count_; }
+
+  /**
+   * @param q quantile to compute, between 0 and 1.
+   * @return double approximate q-quantile of the samples, or 0 if there are
+   * none.
+   */
+  double quantile(double q) const {
+    assert(q >= 0 && q <= 1);
+
+    if (count_ == 0) {
+      return 0;
+    }
+
+    auto rank = static_cast<std::uint64_t>(std::ceil(q * count_));
+    rank = std::max<std::uint64_t>(rank, 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return value(i);
+      }
+    }
+    return value(counts_.size() - 1);
+  }
+
+private:
+  /**
+   * @param x sample.
+   * @return std::size_t index of the bucket counting the sample.
+   */
+  std::size_t index(double x) const {
+    if (!(x > 0)) {
+      return 0;
+    }
+
+    int exponent;
+    // x = mantissa * 2^exponent with mantissa in [0.5, 1)
+    double mantissa = std::frexp(x, &exponent);
+    if (exponent <= min_exponent_) {
+      return 0;
+    }
+
+    auto sub = static_cast<std::size_t>((mantissa - 0.5) * 2 *
+                                        static_cast<double>(sub_buckets_));
+    auto i = 1 + static_cast<std::size_t>(exponent - 1 - min_exponent_) *
+                     sub_buckets_ +
+             sub;
+    return std::min(i, counts_.size() - 1);
+  }
+
+  /**
+   * @param i index of a bucket.
+   * @return double midpoint of the values counted in the bucket.
+   */
+  double value(std::size_t i) const {
+    if (i == 0) {
+      return 0;
+    }
+
+    auto exponent = static_cast<int>((i - 1) / sub_buckets_) + min_exponent_;
+    auto sub = static_cast<double>((i - 1) % sub_buckets_);
+    auto width = 1. / static_cast<double>(sub_buckets_);
+    return std::ldexp(1 + (sub + 0.5) * width, exponent);
+  }
+
+  int min_exponent_;
+  std::size_t sub_buckets_;
+  /// Bucket 0 counts zero, negative and too small samples.
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t count_ = 0;
+};
+
+/**
+ * Streaming estimate of one quantile using the P-square algorithm of Jain and
+ * Chlamtac. Keeps five markers, so recording a sample takes constant time and
+ * memory.
+ */
+class p2_quantile {
+public:
+  /**
+   * @param q quantile to estimate, between 0 and 1.
+   */
+  explicit p2_quantile(double q) : q_{q} {
+    assert(q > 0 && q < 1);
+    desired_ = {1, 1 + 2 * q, 1 + 4 * q, 3 + 2 * q, 5};
+    increments_ = {0, q / 2, q, (1 + q) / 2, 1};
+  }
+
+  /**
+   * @param x sample to record.
+   */
+  void record(double x) {
+    if (count_ < 5) {
+      heights_[count_] = x;
+      ++count_;
+      if (count_ == 5) {
+        std::sort(heights_.begin(), heights_.end());
+        positions_ = {1, 2, 3, 4, 5};
+      }
+      return;
+    }
+    ++count_;
+
+    // find the cell of the sample and update the extreme markers
+    std::size_t k;
+    if (x < heights_[0]) {
+      heights_[0] = x;
+      k = 0;
+    } else if (x >= heights_[4]) {
+      heights_[4] = std::max(heights_[4], x);
+      k = 3;
+    } else {
+      k = 0;
+      while (x >= heights_[k + 1]) {
+        ++k;
+      }
+    }
+
+    for (std::size_t i = k + 1; i < 5; ++i) {
+      positions_[i] += 1;
+    }
+    for (std::size_t i = 0; i < 5; ++i) {
+      desired_[i] += increments_[i];
+    }
+
+    // adjust the heights of the middle markers if necessary
+    for (std::size_t i = 1; i < 4; ++i) {
+      double d = desired_[i] - positions_[i];
+      if ((d >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+          (d <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+        double sign = d >= 0 ? 1 : -1;
+        double height = parabolic(i, sign);
+        if (heights_[i - 1] < height && height < heights_[i + 1]) {
+          heights_[i] = height;
+        } else {
+          heights_[i] = linear(i, sign);
+        }
+        positions_[i] += sign;
+      }
+    }
+  }
+
+  /**
+   * @return std::uint64_t number of recorded samples.
+   */
+  std::uint64_t count() const { return count_; }
+
+  /**
+   * @return double estimate of the quantile, or 0 if there are no samples.
+   */
+  double value() const {
+    if (count_ == 0) {
+      return 0;
+    }
+    if (count_ < 5) {
+      // exact quantile of the few samples seen so far
+      auto sorted = heights_;
+      std::sort(sorted.begin(), sorted.begin() + count_);
+      auto i = static_cast<std::size_t>(q_ * static_cast<double>(count_ - 1));
+      return sorted[i];
+    }
+    return heights_[2];
+  }
+
+private:
+  double parabolic(std::size_t i, double d) const {
+    return heights_[i] +
+           d / (positions_[i + 1] - positions_[i - 1]) *
+               ((positions_[i] - positions_[i - 1] + d) *
+                    (heights_[i + 1] - heights_[i]) /
+                    (positions_[i + 1] - positions_[i]) +
+                (positions_[i + 1] - positions_[i] - d) *
+                    (heights_[i] - heights_[i - 1]) /
+                    (positions_[i] - positions_[i - 1]));
+  }
+
+  double linear(std::size_t i, double d) const {
+    auto j = d > 0 ? i + 1 : i - 1;
+    return heights_[i] +
+           d * (heights_[j] - heights_[i]) / (positions_[j] - positions_[i]);
+  }
+
+  double q_;
+  std::uint64_t count_ = 0;
+  /// Heights of the markers.
+  std::array<double, 5> heights_{};
+  /// Actual positions of the markers.
+  std::array<double, 5> positions_{};
+  /// Desired positions of the markers.
+  std::array<double, 5> desired_{};
+  /// Increments of the desired positions per sample.
+  std::array<double, 5> increments_{};
+};
+
+/**
+ * Batch means estimate of the steady-state mean of a correlated series of
+ * samples, such as successive waiting times. Samples are grouped into batches
+ * of a fixed size and the batch means are treated as independent.
+ */
+class batch_means {
+public:
+  /**
+   * @param batch_size number of samples per batch.
+   */
+  explicit batch_means(std::uint64_t batch_size) : batch_size_{batch_size} {
+    assert(batch_size > 0);
+  }
+
+  /**
+   * @param x sample to record.
+   */
+  void record(double x) {
+    sum_ += x;
+    ++in_batch_;
+    if (in_batch_ == batch_size_) {
+      batches_.record(sum_ / static_cast<double>(batch_size_));
+      sum_ = 0;
+      in_batch_ = 0;
+    }
+  }
+
+  /**
+   * @return std::uint64_t number of completed batches.
+   */
+  std::uint64_t batches() const { return batches_.count(); }
+
+  /**
+   * @return double mean of the completed batches.
+   */
+  double mean() const { return batches_.mean(); }
+
+  /**
+   * @return double half width of the 95% confidence interval of the mean,
+   * using Student's t distribution, or infinity if there are less than two
+   * completed batches.
+   */
+  double half_width() const {
+    auto n = batches_.count();
+    if (n < 2) {
+      return std::numeric_limits<double>::infinity();
+    }
+
+    // two-sided 95% critical values of Student's t distribution
+    static constexpr std::array<double, 30> t = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    auto df = n - 1;
+    double critical = df <= t.size() ? t[df - 1] : 1.960;
+    return critical * batches_.stddev() / std::sqrt(static_cast<double>(n));
+  }
+
+private:
+  std::uint64_t batch_size_;
+  double sum_ = 0;
+  std::uint64_t in_batch_ = 0;
+  tally<double> batches_{};
+};
+
+/**
+ * Time-weighted statistics of a piecewise constant quantity, such as the number
+ * of units in use or the length of a queue. Each change of the quantity
+ * updates the integral over time in constant time.
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <typename Time = double> class time_weighted {
+public:
+  /**
+   * @param now current simulation time.
+   * @param value new value of the quantity from now on.
+   */
+  void update(Time now, double value) {
+    if (!started_) {
+      started_ = true;
+      start_ = now;
+    } else {
+      integral_ += value_ * static_cast<double>(now - last_);
+    }
+    last_ = now;
+    value_ = value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  /**
+   * @param now current simulation time.
+   * @return double time-weighted mean of the quantity from the first update
+   * until now, or the current value if no time has passed.
+   */
+  double mean(Time now) const {
+    auto duration = static_cast<double>(now - start_);
+    if (!started_ || duration <= 0) {
+      return value_;
+    }
+    return (integral_ + value_ * static_cast<double>(now - last_)) / duration;
+  }
+
+  /**
+   * @return double current value of the quantity.
+   */
+  double current() const { return value_; }
+
+  /**
+   * @return double smallest value of the quantity.
+   */
+  double min() const { return min_; }
+
+  /**
+   * @return double largest value of the quantity.
+   */
+  double max() const { return max_; }
+
+private:
+  bool started_ = false;
+  Time start_{};
+  Time last_{};
+  double value_ = 0;
+  /// Integral of the quantity from start_ until last_.
+  double integral_ = 0;
+  double min_ = std::numeric_limits<double>::infinity();
+  double max_ = -std::numeric_limits<double>::infinity();
+};
+
+/**
+ * Statistics collected by a resource or store. Attach it with set_monitor().
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <typename Time = double> struct monitor {
+  /// Number of units in use for resources, or of stored values for stores.
+  time_weighted<Time> level;
+
+  /// Number of waiting requests or gets.
+  time_weighted<Time> queue_length;
+
+  /// Waiting times of granted requests or gets, including zero waits.
+  tally<Time> waiting_time;
+
+  /**
+   * Additional collector the waiting times are recorded into, if set, for
+   * example a log_histogram or p2_quantile:
+   *
+   *     monitor.on_waiting_time = [&](double x) { histogram.record(x); };
+   */
+  std::function<void(double)> on_waiting_time{};
+
+  /**
+   * @param x waiting time to record.
+   */
+  void record_waiting_time(double x) {
+    waiting_time.record(x);
+    if (on_waiting_time) {
+      on_waiting_time(x);
+    }
+  }
+};
+} // namespace simcpp20
@@ -0,0 +1,383 @@
+// Copyright © 2021 Felix Schütz.
+// Licensed under the MIT license. See the LICENSE file for details.
+
+#pragma once
+
+#include <cassert>    // assert
+#include <cstddef>    // std::size_t
+#include <cstdint>    // std::uint64_t
+#include <functional> // std::function
+#include <utility>    // std::move
+
+#include "simcpp20/simcpp20.hpp"
+#include "simcpp20/wait_queue.hpp"
+
+namespace simcpp20 {
+
+/**
+ * Counting semaphore in simulation time. Acquisitions are granted in the order
+ * they were made, so a large acquisition at the front is not starved by
+ * smaller ones behind it.
+ *
+ * To create a new instance, initialize the class passing the simulation and
+ * the initial count:
+ *
+ *     simcpp20::semaphore<> semaphore{sim, 3};
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class semaphore {
+public:
+  /**
+   * @param sim Simulation.
+   * @param count Initial number of available units.
+   */
+  semaphore(simcpp20::simulation<Time> &sim, std::uint64_t count)
+      : sim{sim}, count_{count} {
+    // an aborted acquisition at the front may unblock the ones behind it
+    evs.set_abort_callback([this] { trigger_evs(); });
+  }
+
+  semaphore(const semaphore &) = delete;
+  semaphore &operator=(const semaphore &) = delete;
+
+  /**
+   * @param n Number of units to acquire.
+   * @return New event which is triggered when the units are acquired.
+   */
+  simcpp20::event<Time> acquire(std::uint64_t n = 1) {
+    auto ev = sim.event();
+    evs.push(ev, n);
+    trigger_evs();
+    return ev;
+  }
+
+  /**
+   * Acquire units without waiting, if no earlier acquisition is waiting.
+   *
+   * @param n Number of units to acquire.
+   * @return bool whether the units were acquired.
+   */
+  bool try_acquire(std::uint64_t n = 1) {
+    if (!evs.empty() || count_ < n) {
+      return false;
+    }
+
+    count_ -= n;
+    return true;
+  }
+
+  /**
+   * @param n Number of units to release.
+   */
+  void release(std::uint64_t n = 1) {
+    count_ += n;
+    trigger_evs();
+  }
+
+  /**
+   * @return std::uint64_t number of available units.
+   */
+  std::uint64_t available() const { return count_; }
+
+  /**
+   * @return size_t number of waiting acquisitions.
+   */
+  size_t waiting() const { return evs.size(); }
+
+private:
+  simcpp20::simulation<Time> &sim;
+  std::uint64_t count_;
+  /// Pending acquisitions with the number of units to acquire.
+  wait_queue<simcpp20::event<Time>, std::uint64_t> evs{};
+
+  void trigger_evs() {
+    while (!evs.empty() && evs.front()->payload_ <= count_) {
+      count_ -= evs.front()->payload_;
+      evs.pop().trigger();
+    }
+  }
+};
+
+/**
+ * Reusable barrier for a fixed number of processes in simulation time. Once
+ * all parties arrived, they are released together and the barrier can be used
+ * for the next phase.
+ *
+ * To create a new instance, initialize the class passing the simulation and
+ * the number of parties:
+ *
+ *     simcpp20::barrier<> barrier{sim, 4};
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class barrier {
+public:
+  /**
+   * @param sim Simulation.
+   * @param parties Number of arrivals which complete a phase.
+   */
+  barrier(simcpp20::simulation<Time> &sim, std::uint64_t parties)
+      : sim{sim}, parties_{parties} {
+    assert(parties > 0);
+  }
+
+  barrier(const barrier &) = delete;
+  barrier &operator=(const barrier &) = delete;
+
+  /**
+   * Arrive at the barrier. Aborting the returned event before the phase
+   * completes withdraws the arrival.
+   *
+   * @return New event which is triggered when all parties arrived.
+   */
+  simcpp20::event<Time> arrive_and_wait() {
+    auto ev = sim.event();
+    if (evs.size() + 1 < parties_) {
+      evs.push(ev);
+      return ev;
+    }
+
+    while (!evs.empty()) {
+      evs.pop().trigger();
+    }
+    ev.trigger();
+    ++phase_;
+    return ev;
+  }
+
+  /**
+   * @return std::uint64_t number of parties.
+   */
+  std::uint64_t parties() const { return parties_; }
+
+  /**
+   * @return size_t number of parties waiting in the current phase.
+   */
+  size_t waiting() const { return evs.size(); }
+
+  /**
+   * @return std::uint64_t number of completed phases.
+   */
+  std::uint64_t phase() const { return phase_; }
+
+private:
+  simcpp20::simulation<Time> &sim;
+  std::uint64_t parties_;
+  std::uint64_t phase_ = 0;
+  /// Parties waiting in the current phase.
+  wait_queue<simcpp20::event<Time>> evs{};
+};
+
+/**
+ * One-shot latch in simulation time. Waiters are released once the counter
+ * reaches zero, after which waiting completes immediately.
+ *
+ * To create a new instance, initialize the class passing the simulation and
+ * the initial count:
+ *
+ *     simcpp20::latch<> latch{sim, 4};
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class latch {
+public:
+  /**
+   * @param sim Simulation.
+   * @param count Number of count downs until the latch opens.
+   */
+  latch(simcpp20::simulation<Time> &sim, std::uint64_t count)
+      : sim{sim}, count_{count} {}
+
+  latch(const latch &) = delete;
+  latch &operator=(const latch &) = delete;
+
+  /**
+   * @param n Amount to decrease the counter by. Must not exceed the counter.
+   */
+  void count_down(std::uint64_t n = 1) {
+    assert(n <= count_);
+
+    count_ -= n;
+    if (count_ == 0) {
+      while (!evs.empty()) {
+        evs.pop().trigger();
+      }
+    }
+  }
+
+  /**
+   * @return New event which is triggered when the counter reaches zero.
+   */
+  simcpp20::event<Time> wait() {
+    auto ev = sim.event();
+    if (count_ == 0) {
+      ev.trigger();
+    } else {
+      evs.push(ev);
+    }
+    return ev;
+  }
+
+  /**
+   * @param n Amount to decrease the counter by.
+   * @return New event which is triggered when the counter reaches zero.
+   */
+  simcpp20::event<Time> arrive_and_wait(std::uint64_t n = 1) {
+    count_down(n);
+    return wait();
+  }
+
+  /**
+   * @return bool whether the counter reached zero.
+   */
+  bool try_wait() const { return count_ == 0; }
+
+  /**
+   * @return std::uint64_t current value of the counter.
+   */
+  std::uint64_t count() const { return count_; }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  size_t waiting() const { return evs.size(); }
+
+private:
+  simcpp20::simulation<Time> &sim;
+  std::uint64_t count_;
+  /// Events waiting for the counter to reach zero.
+  wait_queue<simcpp20::event<Time>> evs{};
+};
+
+/**
+ * Condition variable in simulation time. Waiters are only re-checked when the
+ * condition is notified, so waiting for a state change, such as an inventory
+ * level reaching a threshold, schedules no events until it happens.
+ *
+ * To create a new instance, initialize the class passing the simulation:
+ *
+ *     simcpp20::condition<> condition{sim};
+ *
+ * Processes changing the state the predicates depend on must notify the
+ * condition afterwards:
+ *
+ *     co_await condition.wait_until([&] { return inventory >= 10; });
+ *     ...
+ *     inventory += 5;
+ *     condition.notify_all();
+ *
+ * Waiters with predicates are released one at a time: the next predicate is
+ * only checked after the released waiter has run until it suspends again, so
+ * it sees the state the previous waiter left behind. Two consumers waiting
+ * for 10 items each are therefore not both released by an inventory of 15.
+ *
+ * @tparam Time Type used for simulation time.
+ */
+template <class Time = double> class condition {
+public:
+  /**
+   * @param sim Simulation.
+   */
+  explicit condition(simcpp20::simulation<Time> &sim) : sim{sim} {}
+
+  condition(const condition &) = delete;
+  condition &operator=(const condition &) = delete;
+
+  /**
+   * @return New event which is triggered on the next notification.
+   */
+  simcpp20::event<Time> wait() {
+    auto ev = sim.event();
+    evs.push(ev);
+    return ev;
+  }
+
+  /**
+   * @param pred Predicate to wait for. Evaluated now and on each notification
+   * until it holds.
+   * @return New event which is triggered once the predicate holds.
+   */
+  simcpp20::event<Time> wait_until(std::function<bool()> pred) {
+    auto ev = sim.event();
+    if (pred()) {
+      ev.trigger();
+    } else {
+      evs.push(ev, std::move(pred));
+    }
+    return ev;
+  }
+
+  /**
+   * Release the oldest waiter whose predicate holds, if any.
+   */
+  void notify_one() {
+    for (auto e = evs.front(); e != nullptr; e = e->next()) {
+      if (ready(e)) {
+        release(e);
+        return;
+      }
+    }
+  }
+
+  /**
+   * Release all plain waiters, and the waiters with predicates one at a time
+   * as long as the oldest waiter whose predicate holds is found.
+   */
+  void notify_all() {
+    for (auto e = evs.front(); e != nullptr;) {
+      auto next = e->next();
+      if (!e->payload_) {
+        release(e);
+      }
+      e = next;
+    }
+    notify_next();
+  }
+
+  /**
+   * @return size_t number of waiting events.
+   */
+  size_t waiting() const { return evs.size(); }
+
+private:
+  typedef wait_queue<simcpp20::event<Time>, std::function<bool()>> queue_type;
+
+  simcpp20::simulation<Time> &sim;
+  /// Waiting events with their predicates, empty for plain waits.
+  queue_type evs{};
+
+  /**
+   * @param e Entry of a waiting event.
+   * @return bool whether the event can be released.
+   */
+  static bool ready(typename queue_type::entry *e) {
+    return !e->payload_ || e->payload_();
+  }
+
+  /**
+   * Release the oldest waiter with a predicate which holds, and check the
+   * others again once it has run.
+   */
+  void notify_next() {
+    for (auto e = evs.front(); e != nullptr; e = e->next()) {
+      if (e->payload_ && e->payload_()) {
+        release(e);
+        // processed after the released event, so after the waiter has run
+        sim.timeout(0).add_callback([this](const auto &) { notify_next(); });
+        return;
+      }
+    }
+  }
+
+  /**
+   * @param e Entry of a waiting event to release.
+   */
+  void release(typename queue_type::entry *e) {
+    auto ev = e->ev_;
+    evs.erase(e);
+    ev.trigger();
+  }
+};
+
+} // namespace simcpp20
@@ -2,12 +2,21 @@
 // Licensed under the MIT license. See the LICENSE file for details.
 
 #include <algorithm>
+#include <any>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
 
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/generators/catch_generators.hpp"
 #include "simcpp20/simcpp20.hpp"
 #include "simcpp20/resource.hpp"
+#include "simcpp20/select.hpp"
+#include "simcpp20/statistics.hpp"
+#include "simcpp20/sync.hpp"
 
 simcpp20::event<> awaiter(simcpp20::simulation<> &sim, simcpp20::event<> ev,
                           double target, bool &finished) {
@@ -94,6 +103,181 @@ TEST_CASE("boolean logic") {
   }
 }
 
+TEST_CASE("resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::resource<> resource{sim, 1};
+
+  SECTION("request() waits for release()") {
+    auto ev_1 = resource.request(), ev_2 = resource.request();
+
+    sim.run_until(2);
+    REQUIRE(ev_1.processed());
+    REQUIRE(ev_2.pending());
+    REQUIRE(resource.waiting() == 1);
+    resource.release();
+    sim.run();
+
+    REQUIRE(ev_2.processed());
+    REQUIRE(resource.waiting() == 0);
+    REQUIRE(resource.available() == 0);
+  }
+
+  SECTION("aborted request() is removed from the queue immediately") {
+    auto ev_1 = resource.request(), ev_2 = resource.request(),
+         ev_3 = resource.request();
+
+    REQUIRE(resource.waiting() == 2);
+    ev_2.abort();
+    REQUIRE(resource.waiting() == 1);
+    resource.release();
+    sim.run();
+
+    REQUIRE(ev_2.aborted());
+    REQUIRE(ev_3.processed());
+    REQUIRE(resource.waiting() == 0);
+  }
+}
+
+TEST_CASE("priority resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::priority_resource<> resource{sim, 1};
+  auto ev_0 = resource.request();
+
+  SECTION("higher priority request() is granted first, even if newer") {
+    auto ev_1 = resource.request(1), ev_2 = resource.request(0);
+
+    resource.release();
+    sim.run();
+
+    REQUIRE(ev_1.pending());
+    REQUIRE(ev_2.processed());
+    REQUIRE(resource.waiting() == 1);
+  }
+
+  SECTION("request() with the same priority is granted in order") {
+    auto ev_1 = resource.request(1), ev_2 = resource.request(1);
+
+    resource.release();
+    sim.run();
+
+    REQUIRE(ev_1.processed());
+    REQUIRE(ev_2.pending());
+  }
+
+  SECTION("aborted request() is removed from the queue immediately") {
+    auto ev_1 = resource.request(0), ev_2 = resource.request(1),
+         ev_3 = resource.request(2);
+
+    REQUIRE(resource.waiting() == 3);
+    ev_1.abort();
+    REQUIRE(resource.waiting() == 2);
+    resource.release();
+    sim.run();
+
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_3.pending());
+    REQUIRE(resource.waiting() == 1);
+  }
+}
+
+TEST_CASE("preemptive resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::preemptive_resource<> resource{sim, 1};
+  auto ev_0 = resource.request(1);
+
+  SECTION("higher priority request() preempts the holder") {
+    sim.run_until(2);
+    auto preempted = resource.preempted(ev_0);
+    auto ev_1 = resource.request(0);
+    sim.run();
+
+    REQUIRE(ev_1.processed());
+    REQUIRE(preempted.processed());
+    REQUIRE(preempted.value().time == 2);
+    REQUIRE(preempted.value().usage == 2);
+    REQUIRE(resource.users() == 1);
+
+    resource.release(ev_0);
+    REQUIRE(resource.available() == 0);
+    resource.release(ev_1);
+    REQUIRE(resource.available() == 1);
+    REQUIRE(resource.users() == 0);
+  }
+
+  SECTION("request() with the same priority does not preempt the holder") {
+    sim.run_until(2);
+    auto preempted = resource.preempted(ev_0);
+    auto ev_1 = resource.request(1);
+    sim.run();
+
+    REQUIRE(ev_1.pending());
+    REQUIRE(preempted.pending());
+    resource.release(ev_0);
+    sim.run();
+
+    REQUIRE(ev_1.processed());
+  }
+
+  SECTION("request() without preempt waits for release()") {
+    sim.run_until(2);
+    auto ev_1 = resource.request(0, false);
+    sim.run();
+
+    REQUIRE(ev_1.pending());
+    REQUIRE(resource.preempted(ev_0).pending());
+    REQUIRE(resource.waiting() == 1);
+  }
+}
+
+TEST_CASE("container resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::container<> tank{sim, 10, 5};
+
+  SECTION("get() waits until the level is high enough") {
+    auto ev = tank.get(8);
+
+    sim.run_until(2);
+    REQUIRE(ev.pending());
+    REQUIRE(tank.waiting_gets() == 1);
+    tank.put(2.5);
+    sim.run();
+    REQUIRE(ev.pending());
+    tank.put(0.5);
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(tank.level() == 0);
+    REQUIRE(tank.waiting_gets() == 0);
+  }
+
+  SECTION("put() waits until there is enough space") {
+    auto ev = tank.put(7);
+
+    sim.run_until(2);
+    REQUIRE(ev.pending());
+    REQUIRE(tank.waiting_puts() == 1);
+    tank.get(2);
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(tank.level() == 10);
+  }
+
+  SECTION("waiting get() are satisfied in order") {
+    auto ev_1 = tank.get(8), ev_2 = tank.get(1);
+
+    sim.run();
+    REQUIRE(ev_1.pending());
+    REQUIRE(ev_2.pending());
+    ev_1.abort();
+    REQUIRE(tank.waiting_gets() == 0);
+    sim.run();
+
+    REQUIRE(ev_2.processed());
+    REQUIRE(tank.level() == 4);
+  }
+}
+
 TEST_CASE("store resource") {
   simcpp20::simulation<> sim;
   simcpp20::store<int> store{sim}; 
@@ -139,6 +323,250 @@ TEST_CASE("store resource") {
     REQUIRE(store.size() == 1);
     REQUIRE(ev.aborted());
   }
+
+  SECTION("aborted get() is removed from the queue immediately") {
+    auto ev_1 = store.get(), ev_2 = store.get();
+
+    REQUIRE(store.waiting() == 2);
+    ev_1.abort();
+    REQUIRE(store.waiting() == 1);
+    store.put(42);
+    sim.run();
+
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_2.value() == 42);
+    REQUIRE(store.waiting() == 0);
+  }
+}
+
+TEST_CASE("store resource with try_put") {
+  simcpp20::simulation<> sim;
+
+  SECTION("try_put() stores the value without scheduling an event") {
+    simcpp20::store<int> store{sim};
+    auto ev = store.get();
+
+    REQUIRE(store.try_put(42));
+    REQUIRE(store.try_put(43));
+    REQUIRE(store.size() == 1);
+    sim.run();
+
+    REQUIRE(ev.value() == 42);
+  }
+
+  SECTION("try_put() fails on a full store") {
+    simcpp20::store<int> store{sim, 1};
+
+    REQUIRE(store.try_put(42));
+    REQUIRE(!store.try_put(43));
+    REQUIRE(store.size() == 1);
+    REQUIRE(sim.empty());
+  }
+
+  SECTION("try_put() on filtered and priority stores") {
+    simcpp20::filtered_store<int> filtered_store{sim};
+    simcpp20::priority_store<int> priority_store{sim, 1};
+    auto ev = filtered_store.get([](auto v) { return v >= 40; });
+
+    REQUIRE(filtered_store.try_put(42));
+    REQUIRE(priority_store.try_put(42));
+    REQUIRE(!priority_store.try_put(43));
+    sim.run();
+
+    REQUIRE(ev.value() == 42);
+    REQUIRE(priority_store.get(0).value() == 42);
+  }
+}
+
+TEST_CASE("store resource with batches") {
+  simcpp20::simulation<> sim;
+  simcpp20::store<int> store{sim};
+
+  SECTION("put_n() stores all values in order") {
+    auto ev = store.put_n(std::vector<int>{1, 2, 3});
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(store.size() == 3);
+    REQUIRE(store.get().value() == 1);
+  }
+
+  SECTION("get_n() waits until enough values are available") {
+    auto ev = store.get_n(3);
+
+    store.put_n(std::vector<int>{1, 2});
+    sim.run();
+    REQUIRE(ev.pending());
+    store.put(3);
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(ev.value() == std::vector<int>{1, 2, 3});
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("get_up_to() takes the available values") {
+    std::vector<int> values{1, 2};
+    store.put_n(values);
+    auto ev = store.get_up_to(3);
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(ev.value() == values);
+  }
+
+  SECTION("gets are served in order") {
+    auto ev_1 = store.get_n(2);
+    auto ev_2 = store.get();
+
+    store.put(1);
+    sim.run();
+    REQUIRE(ev_1.pending());
+    REQUIRE(ev_2.pending());
+    REQUIRE(store.waiting() == 2);
+
+    ev_1.abort();
+    sim.run();
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_2.value() == 1);
+  }
+}
+
+TEST_CASE("bounded store resource with batches") {
+  simcpp20::simulation<> sim;
+  simcpp20::store<int> store{sim, 2};
+
+  SECTION("put_n() on a full store waits for get_n()") {
+    auto put_ev = store.put_n(std::vector<int>{1, 2, 3, 4});
+    sim.run();
+    REQUIRE(put_ev.pending());
+    REQUIRE(store.waiting_puts() == 2);
+
+    auto get_ev = store.get_n(2);
+    sim.run();
+
+    REQUIRE(get_ev.value() == std::vector<int>{1, 2});
+    REQUIRE(put_ev.processed());
+    REQUIRE(store.size() == 2);
+  }
+}
+
+TEST_CASE("store resource with move-only values") {
+  simcpp20::simulation<> sim;
+  simcpp20::store<std::unique_ptr<int>> store{sim};
+
+  SECTION("values are moved through the store") {
+    for (int i = 0; i < 20; ++i) {
+      store.put(std::make_unique<int>(i));
+    }
+    REQUIRE(store.size() == 20);
+
+    for (int i = 0; i < 20; ++i) {
+      auto ev = store.get();
+      REQUIRE(*ev.value() == i);
+    }
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("waiting get() receives the moved value") {
+    auto ev = store.get();
+    store.put(std::make_unique<int>(42));
+    sim.run();
+
+    auto value = std::move(ev.value());
+    REQUIRE(*value == 42);
+  }
+}
+
+struct move_counter {
+  explicit move_counter(int &moves) : moves{&moves} {}
+  move_counter(move_counter &&other) : moves{other.moves} { ++*moves; }
+  int *moves;
+};
+
+TEST_CASE("store resource hands values off to waiting get()") {
+  simcpp20::simulation<> sim;
+  int moves = 0;
+
+  SECTION("store") {
+    simcpp20::store<move_counter> store{sim};
+    auto ev = store.get();
+    store.put(moves);
+    REQUIRE(ev.triggered());
+    REQUIRE(moves == 0);
+  }
+
+  SECTION("filtered store") {
+    simcpp20::filtered_store<move_counter> store{sim};
+    auto ev = store.get();
+    store.put(moves);
+    REQUIRE(ev.triggered());
+    REQUIRE(moves == 1);
+  }
+
+  SECTION("priority store") {
+    simcpp20::priority_store<move_counter> store{sim};
+    auto ev = store.get(0);
+    store.put(moves);
+    REQUIRE(ev.triggered());
+    REQUIRE(moves == 0);
+  }
+}
+
+TEST_CASE("bounded store resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::store<int> store{sim, 1};
+
+  SECTION("put() on a full store waits for get()") {
+    auto put_ev_1 = store.put(1), put_ev_2 = store.put(2),
+         put_ev_3 = store.put(3);
+
+    sim.run_until(2);
+    REQUIRE(put_ev_1.processed());
+    REQUIRE(put_ev_2.pending());
+    REQUIRE(store.size() == 1);
+    REQUIRE(store.waiting_puts() == 2);
+
+    auto get_ev = store.get();
+    sim.run();
+
+    REQUIRE(get_ev.value() == 1);
+    REQUIRE(put_ev_2.processed());
+    REQUIRE(put_ev_3.pending());
+    REQUIRE(store.size() == 1);
+    REQUIRE(store.get().value() == 2);
+    REQUIRE(store.waiting_puts() == 0);
+  }
+
+  SECTION("aborted put() does not add its value") {
+    store.put(1);
+    auto put_ev_2 = store.put(2), put_ev_3 = store.put(3);
+
+    put_ev_2.abort();
+    REQUIRE(store.waiting_puts() == 1);
+    REQUIRE(store.get().value() == 1);
+    REQUIRE(store.get().value() == 3);
+  }
+}
+
+TEST_CASE("bounded priority store resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::priority_store<int> store{sim, 1};
+
+  SECTION("put() on a full store waits for get()") {
+    auto put_ev_1 = store.put(1), put_ev_2 = store.put(2);
+
+    sim.run();
+    REQUIRE(put_ev_1.processed());
+    REQUIRE(put_ev_2.pending());
+
+    auto get_ev = store.get(0);
+    sim.run();
+
+    REQUIRE(get_ev.value() == 1);
+    REQUIRE(put_ev_2.processed());
+    REQUIRE(store.size() == 1);
+  }
 }
 
 TEST_CASE("filtered store resource") {
@@ -187,6 +615,38 @@ TEST_CASE("filtered store resource") {
     REQUIRE(ev.aborted());
   }
 
+  SECTION("aborted get() is removed from the queue immediately") {
+    auto ev_1 = store.get([](auto v) { return v >= 40; }),
+         ev_2 = store.get([](auto v) { return v >= 40; });
+
+    REQUIRE(store.waiting() == 2);
+    ev_1.abort();
+    REQUIRE(store.waiting() == 1);
+    store.put(42);
+    sim.run();
+
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_2.value() == 42);
+    REQUIRE(store.waiting() == 0);
+  }
+
+  SECTION("put() value goes to the oldest matching get()") {
+    auto ev_1 = store.get([](auto v) { return v < 0; }),
+         ev_2 = store.get([](auto v) { return v >= 40; }),
+         ev_3 = store.get([](auto v) { return v >= 40; });
+
+    store.put(42);
+    store.put(-1);
+    store.put(7);
+    sim.run();
+
+    REQUIRE(ev_1.value() == -1);
+    REQUIRE(ev_2.value() == 42);
+    REQUIRE(ev_3.pending());
+    REQUIRE(store.size() == 1);
+    REQUIRE(store.waiting() == 1);
+  }
+
   SECTION("older get() will get the value when available") {
     auto ev_1 = store.get([](auto v) { return v >= 40;}), ev_2 = store.get([](auto v) { return v < 0; });
     
@@ -220,21 +680,64 @@ TEST_CASE("filtered store resource") {
   }
 }
 
-TEST_CASE("priority store resource") {
+TEST_CASE("keyed store resource") {
   simcpp20::simulation<> sim;
-  simcpp20::priority_store<int> store{sim}; 
+  simcpp20::keyed_store<int, int> store{sim};
+
+  SECTION("get() only retrieves values with its key") {
+    auto ev_1 = store.get(1), ev_2 = store.get(2);
 
-  SECTION("store makes get() wait for put()") {
-    auto ev = store.get(0);
-    
     sim.run_until(2);
-    REQUIRE(ev.pending());
-    store.put(42);
+    store.put(2, 42);
+    store.put(3, 43);
     sim.run();
 
-    REQUIRE(ev.processed());
-    REQUIRE(ev.value() == 42);
-    REQUIRE(store.size() == 0);
+    REQUIRE(ev_1.pending());
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_2.value() == 42);
+    REQUIRE(store.size() == 1);
+    REQUIRE(store.size(3) == 1);
+    REQUIRE(store.waiting() == 1);
+  }
+
+  SECTION("values with the same key are retrieved in order") {
+    store.put(1, 42);
+    store.put(1, 43);
+
+    REQUIRE(store.get(1).value() == 42);
+    REQUIRE(store.get(1).value() == 43);
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("aborted get() do not get the value") {
+    auto ev_1 = store.get(1), ev_2 = store.get(1);
+
+    ev_1.abort();
+    REQUIRE(store.waiting() == 1);
+    ev_2.abort();
+    REQUIRE(store.waiting() == 0);
+    store.put(1, 42);
+    sim.run();
+
+    REQUIRE(store.size() == 1);
+  }
+}
+
+TEST_CASE("priority store resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::priority_store<int> store{sim}; 
+
+  SECTION("store makes get() wait for put()") {
+    auto ev = store.get(0);
+    
+    sim.run_until(2);
+    REQUIRE(ev.pending());
+    store.put(42);
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(ev.value() == 42);
+    REQUIRE(store.size() == 0);
   }
 
   SECTION("store does not make put() wait for get()") {
@@ -315,4 +818,1126 @@ TEST_CASE("priority store resource") {
     REQUIRE(ev_2.processed());
     REQUIRE(ev_2.value() == 42);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("item priority store resource") {
+  simcpp20::simulation<> sim;
+  simcpp20::item_priority_store<std::pair<int, int>> store{sim};
+
+  SECTION("get() retrieves the value with the highest priority") {
+    store.put(2, 0);
+    store.put(0, 1);
+    store.put(1, 2);
+
+    REQUIRE(store.get().value().second == 1);
+    REQUIRE(store.get().value().second == 2);
+    REQUIRE(store.get().value().second == 0);
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("store makes get() wait for put()") {
+    auto ev_1 = store.get(), ev_2 = store.get();
+
+    sim.run_until(2);
+    REQUIRE(store.waiting() == 2);
+    store.put(1, 0);
+    sim.run();
+
+    REQUIRE(ev_1.processed());
+    REQUIRE(ev_1.value().second == 0);
+    REQUIRE(ev_2.pending());
+  }
+}
+
+TEST_CASE("monitors") {
+  simcpp20::simulation<> sim;
+  simcpp20::monitor<> monitor;
+
+  SECTION("resource records utilisation, queue length and waiting times") {
+    simcpp20::resource<> resource{sim, 1};
+    resource.set_monitor(&monitor);
+
+    resource.request();
+    auto ev = resource.request();
+    sim.run_until(2);
+    resource.release();
+    sim.run_until(4);
+    resource.release();
+    sim.run_until(8);
+
+    REQUIRE(monitor.level.mean(sim.now()) == 0.5);
+    REQUIRE(monitor.queue_length.mean(sim.now()) == 0.25);
+    REQUIRE(monitor.queue_length.max() == 1);
+    REQUIRE(monitor.waiting_time.count() == 2);
+    REQUIRE(monitor.waiting_time.mean() == 1);
+    REQUIRE(monitor.waiting_time.max() == 2);
+  }
+
+  SECTION("aborted requests update the queue length") {
+    simcpp20::resource<> resource{sim, 0};
+    resource.set_monitor(&monitor);
+
+    auto ev = resource.request();
+    sim.run_until(1);
+    ev.abort();
+    sim.run_until(4);
+
+    REQUIRE(monitor.queue_length.current() == 0);
+    REQUIRE(monitor.queue_length.mean(sim.now()) == 0.25);
+    REQUIRE(monitor.waiting_time.count() == 0);
+  }
+
+  SECTION("store records stored values and waiting gets") {
+    simcpp20::store<int> store{sim};
+    store.set_monitor(&monitor);
+
+    auto ev = store.get();
+    sim.run_until(2);
+    store.put(1);
+    store.put(2);
+    sim.run_until(4);
+
+    REQUIRE(monitor.level.mean(sim.now()) == 0.5);
+    REQUIRE(monitor.queue_length.mean(sim.now()) == 0.5);
+    REQUIRE(monitor.waiting_time.mean() == 2);
+  }
+
+  SECTION("filtered and priority stores record waiting gets") {
+    simcpp20::filtered_store<int> filtered_store{sim};
+    simcpp20::priority_store<int> priority_store{sim};
+    simcpp20::monitor<> other_monitor;
+    filtered_store.set_monitor(&monitor);
+    priority_store.set_monitor(&other_monitor);
+
+    filtered_store.get([](auto v) { return v > 0; });
+    priority_store.get(0);
+    sim.run_until(3);
+    filtered_store.put(1);
+    priority_store.put(1);
+
+    REQUIRE(monitor.waiting_time.mean() == 3);
+    REQUIRE(other_monitor.waiting_time.mean() == 3);
+    REQUIRE(monitor.queue_length.current() == 0);
+    REQUIRE(other_monitor.queue_length.current() == 0);
+  }
+}
+
+TEST_CASE("tally") {
+  simcpp20::tally<> tally;
+  for (double x : {2, 4, 4, 4, 5, 5, 7, 9}) {
+    tally.record(x);
+  }
+
+  REQUIRE(tally.count() == 8);
+  REQUIRE(tally.mean() == 5);
+  REQUIRE(std::abs(tally.variance() - 32. / 7) < 1e-12);
+  REQUIRE(tally.min() == 2);
+  REQUIRE(tally.max() == 9);
+}
+
+TEST_CASE("log histogram") {
+  simcpp20::log_histogram histogram;
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.record(i);
+  }
+  histogram.record(0);
+
+  REQUIRE(histogram.count() == 1001);
+  REQUIRE(histogram.quantile(0) == 0);
+  REQUIRE(std::abs(histogram.quantile(0.5) - 500) < 500. / 64);
+  REQUIRE(std::abs(histogram.quantile(0.99) - 990) < 990. / 64);
+  REQUIRE(std::abs(histogram.quantile(1) - 1000) < 1000. / 64);
+}
+
+TEST_CASE("p2 quantile") {
+  simcpp20::p2_quantile median{0.5};
+  simcpp20::p2_quantile p90{0.9};
+  // deterministic permutation of 0, ..., 9999
+  for (int i = 0; i < 10000; ++i) {
+    double x = (i * 7919) % 10000;
+    median.record(x);
+    p90.record(x);
+  }
+
+  REQUIRE(median.count() == 10000);
+  REQUIRE(std::abs(median.value() - 5000) < 100);
+  REQUIRE(std::abs(p90.value() - 9000) < 100);
+}
+
+TEST_CASE("batch means") {
+  simcpp20::batch_means means{10};
+  for (int i = 0; i < 95; ++i) {
+    means.record(i % 10);
+  }
+
+  REQUIRE(means.batches() == 9);
+  REQUIRE(means.mean() == 4.5);
+  REQUIRE(means.half_width() == 0);
+
+  simcpp20::batch_means few{10};
+  REQUIRE(few.half_width() == std::numeric_limits<double>::infinity());
+}
+
+TEST_CASE("monitor records waiting times into additional collectors") {
+  simcpp20::simulation<> sim;
+  simcpp20::monitor<> monitor;
+  simcpp20::log_histogram histogram;
+  monitor.on_waiting_time = [&](double x) { histogram.record(x); };
+
+  simcpp20::resource<> resource{sim, 1};
+  resource.set_monitor(&monitor);
+  resource.request();
+  resource.request();
+  sim.run_until(4);
+  resource.release();
+
+  REQUIRE(histogram.count() == 2);
+  REQUIRE(histogram.quantile(0.5) == 0);
+  REQUIRE(std::abs(histogram.quantile(1) - 4) < 4. / 64);
+}
+
+TEST_CASE("semaphore") {
+  simcpp20::simulation<> sim;
+  simcpp20::semaphore<> semaphore{sim, 3};
+
+  SECTION("acquire() is granted in order once enough units are available") {
+    auto ev_1 = semaphore.acquire(2), ev_2 = semaphore.acquire(2),
+         ev_3 = semaphore.acquire(1);
+
+    sim.run();
+    REQUIRE(ev_1.processed());
+    REQUIRE(ev_2.pending());
+    REQUIRE(ev_3.pending());
+    REQUIRE(!semaphore.try_acquire());
+
+    semaphore.release(2);
+    sim.run();
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_3.processed());
+    REQUIRE(semaphore.available() == 0);
+  }
+
+  SECTION("aborted acquire() at the front unblocks the next one") {
+    auto ev_1 = semaphore.acquire(4), ev_2 = semaphore.acquire(1);
+
+    REQUIRE(semaphore.waiting() == 2);
+    ev_1.abort();
+    sim.run();
+    REQUIRE(ev_2.processed());
+    REQUIRE(semaphore.waiting() == 0);
+    REQUIRE(semaphore.available() == 2);
+  }
+}
+
+simcpp20::event<> phase_worker(simcpp20::simulation<> &sim,
+                               simcpp20::barrier<> &barrier, double duration,
+                               std::vector<double> &finished) {
+  for (int i = 0; i < 2; ++i) {
+    co_await sim.timeout(duration);
+    co_await barrier.arrive_and_wait();
+    finished.push_back(sim.now());
+  }
+}
+
+TEST_CASE("barrier") {
+  simcpp20::simulation<> sim;
+  simcpp20::barrier<> barrier{sim, 3};
+  std::vector<double> finished;
+
+  phase_worker(sim, barrier, 1, finished);
+  phase_worker(sim, barrier, 2, finished);
+  phase_worker(sim, barrier, 3, finished);
+  sim.run();
+
+  REQUIRE(finished == std::vector<double>{3, 3, 3, 6, 6, 6});
+  REQUIRE(barrier.phase() == 2);
+  REQUIRE(barrier.waiting() == 0);
+
+  SECTION("aborted arrival is withdrawn") {
+    auto ev_1 = barrier.arrive_and_wait(), ev_2 = barrier.arrive_and_wait();
+    ev_1.abort();
+    auto ev_3 = barrier.arrive_and_wait();
+    sim.run();
+
+    REQUIRE(ev_2.pending());
+    REQUIRE(ev_3.pending());
+    REQUIRE(barrier.waiting() == 2);
+  }
+}
+
+TEST_CASE("latch") {
+  simcpp20::simulation<> sim;
+  simcpp20::latch<> latch{sim, 2};
+
+  auto ev_1 = latch.wait();
+  latch.count_down();
+  sim.run();
+  REQUIRE(ev_1.pending());
+  REQUIRE(!latch.try_wait());
+
+  auto ev_2 = latch.arrive_and_wait();
+  sim.run();
+  REQUIRE(ev_1.processed());
+  REQUIRE(ev_2.processed());
+  REQUIRE(latch.try_wait());
+
+  auto ev_3 = latch.wait();
+  sim.run();
+  REQUIRE(ev_3.processed());
+}
+
+simcpp20::event<> inventory_consumer(simcpp20::simulation<> &sim,
+                                     simcpp20::condition<> &condition,
+                                     int &inventory, int amount,
+                                     std::vector<double> &served) {
+  co_await condition.wait_until([&] { return inventory >= amount; });
+  inventory -= amount;
+  served.push_back(sim.now());
+}
+
+TEST_CASE("condition") {
+  simcpp20::simulation<> sim;
+  simcpp20::condition<> condition{sim};
+  int inventory = 0;
+  std::vector<double> served;
+
+  SECTION("wait_until() is released once notified with the predicate true") {
+    inventory_consumer(sim, condition, inventory, 10, served);
+    sim.run();
+    REQUIRE(condition.waiting() == 1);
+
+    sim.timeout(1).add_callback([&](const auto &) {
+      inventory += 5;
+      condition.notify_all();
+    });
+    sim.timeout(2).add_callback([&](const auto &) {
+      inventory += 5;
+      condition.notify_all();
+    });
+    sim.run();
+
+    REQUIRE(served == std::vector<double>{2});
+    REQUIRE(inventory == 0);
+    REQUIRE(condition.waiting() == 0);
+  }
+
+  SECTION("wait_until() completes immediately if the predicate holds") {
+    inventory = 10;
+    inventory_consumer(sim, condition, inventory, 10, served);
+    sim.run();
+
+    REQUIRE(served == std::vector<double>{0});
+  }
+
+  SECTION("notify_all() only releases waiters the state still allows") {
+    inventory_consumer(sim, condition, inventory, 10, served);
+    inventory_consumer(sim, condition, inventory, 10, served);
+    sim.run();
+
+    sim.timeout(1).add_callback([&](const auto &) {
+      inventory += 15;
+      condition.notify_all();
+    });
+    sim.run();
+
+    REQUIRE(served == std::vector<double>{1});
+    REQUIRE(inventory == 5);
+    REQUIRE(condition.waiting() == 1);
+
+    inventory += 5;
+    condition.notify_all();
+    sim.run();
+    REQUIRE(served == std::vector<double>{1, 1});
+    REQUIRE(inventory == 0);
+  }
+
+  SECTION("notify_one() releases only the oldest ready waiter") {
+    auto ev_1 = condition.wait_until([&] { return inventory >= 10; });
+    auto ev_2 = condition.wait(), ev_3 = condition.wait();
+
+    condition.notify_one();
+    sim.run();
+    REQUIRE(ev_1.pending());
+    REQUIRE(ev_2.processed());
+    REQUIRE(ev_3.pending());
+
+    inventory = 10;
+    condition.notify_all();
+    sim.run();
+    REQUIRE(ev_1.processed());
+    REQUIRE(ev_3.processed());
+  }
+}
+
+simcpp20::event<> checked_waiter(simcpp20::simulation<> &sim,
+                                 simcpp20::event<> ev, std::string &log) {
+  auto result = co_await ev.checked();
+  switch (result.status) {
+  case simcpp20::await_status::processed:
+    log += "processed";
+    break;
+  case simcpp20::await_status::aborted:
+    log += "aborted";
+    break;
+  case simcpp20::await_status::interrupted:
+    log += std::any_cast<std::string>(result.cause);
+    break;
+  case simcpp20::await_status::failed:
+    log += "failed";
+    break;
+  }
+  log += "@" + std::to_string(int(sim.now()));
+}
+
+simcpp20::value_event<int> failing(simcpp20::simulation<> &sim) {
+  co_await sim.timeout(2);
+  throw std::runtime_error{"failure"};
+}
+
+TEST_CASE("select") {
+  simcpp20::simulation<> sim;
+  simcpp20::store<int> a{sim}, b{sim};
+  auto get_a = [&] { return a.get(); };
+  auto get_b = [&] { return b.get(); };
+
+  SECTION("select() only takes a value from the first ready store") {
+    a.put(1);
+    b.put(2);
+    auto ev = simcpp20::select<int>(sim, get_a, get_b);
+    sim.run();
+
+    REQUIRE(ev.processed());
+    REQUIRE(ev.value().index == 0);
+    REQUIRE(ev.value().value == 1);
+    REQUIRE(b.size() == 1);
+  }
+
+  SECTION("select() withdraws the other gets without losing values") {
+    auto ev = simcpp20::select<int>(sim, get_a, get_b);
+    REQUIRE(a.waiting() == 1);
+    REQUIRE(b.waiting() == 1);
+
+    b.put(2);
+    a.put(1);
+    sim.run();
+
+    REQUIRE(ev.value().index == 1);
+    REQUIRE(ev.value().value == 2);
+    REQUIRE(a.waiting() == 0);
+    REQUIRE(b.waiting() == 0);
+    REQUIRE(a.size() == 1);
+  }
+
+  SECTION("select() over events without values") {
+    auto ev = simcpp20::select<int>(sim, get_a, sim.timeout(5));
+    sim.run();
+
+    REQUIRE(ev.value().index == 1);
+    REQUIRE(!ev.value().value);
+    REQUIRE(sim.now() == 5);
+    REQUIRE(a.waiting() == 0);
+  }
+
+  SECTION("select() on two gets of one store loses no values") {
+    auto ev = simcpp20::select<int>(sim, get_a, get_a);
+    auto other = a.get();
+    a.put_n(std::vector<int>{1, 2, 3});
+    sim.run();
+
+    REQUIRE(ev.value().index == 0);
+    REQUIRE(ev.value().value == 1);
+    REQUIRE(other.value() == 2);
+    REQUIRE(a.size() == 1);
+    REQUIRE(a.waiting() == 0);
+  }
+
+  SECTION("select() fails if the first ready process fails") {
+    std::string log;
+    auto ev = simcpp20::select<int>(sim, failing(sim), sim.timeout(5));
+    checked_waiter(sim, ev, log);
+    sim.run();
+
+    REQUIRE(log == "failed@2");
+    REQUIRE(ev.exception() != nullptr);
+  }
+
+  SECTION("select() keeps events other processes depend on") {
+    std::string log;
+    auto shared = sim.event();
+    checked_waiter(sim, shared, log);
+    auto worker = failing(sim);
+    auto ev = simcpp20::select<int>(sim, get_a, shared, worker);
+    a.put(1);
+    sim.run_until(1);
+
+    REQUIRE(ev.value().index == 0);
+    REQUIRE(shared.pending());
+    REQUIRE(worker.pending());
+
+    shared.trigger();
+    worker.defuse();
+    sim.run();
+    REQUIRE(log == "processed@1");
+    REQUIRE(worker.exception() != nullptr);
+  }
+
+  SECTION("select() on one event from two selects decides both") {
+    auto shared = sim.event();
+    auto ev_1 = simcpp20::select<int>(sim, get_a, shared);
+    auto ev_2 = simcpp20::select<int>(sim, shared, get_b);
+    shared.trigger();
+    sim.run();
+
+    REQUIRE(ev_1.value().index == 1);
+    REQUIRE(ev_2.value().index == 0);
+    REQUIRE(a.waiting() == 0);
+    REQUIRE(b.waiting() == 0);
+  }
+
+  SECTION("aborting select() withdraws all gets") {
+    auto ev = simcpp20::select<int>(sim, get_a, get_b);
+    ev.abort();
+    a.put(1);
+    sim.run();
+
+    REQUIRE(a.waiting() == 0);
+    REQUIRE(b.waiting() == 0);
+    REQUIRE(a.size() == 1);
+  }
+}
+
+TEST_CASE("broadcast store") {
+  simcpp20::simulation<> sim;
+  simcpp20::broadcast_store<int> store{sim};
+
+  SECTION("put() is delivered to all current subscribers") {
+    store.put(0);
+    auto sub_1 = store.subscribe(), sub_2 = store.subscribe();
+    auto ev_1 = store.get(sub_1);
+    store.put(1);
+    store.put(2);
+    auto ev_2 = store.get(sub_2), ev_3 = store.get(sub_2);
+    sim.run();
+
+    REQUIRE(*ev_1.value() == 1);
+    REQUIRE(*ev_2.value() == 1);
+    REQUIRE(*ev_3.value() == 2);
+    // the value is shared, not copied per subscriber
+    REQUIRE(ev_1.value() == ev_2.value());
+    REQUIRE(store.size() == 1);
+    REQUIRE(store.size(sub_1) == 1);
+    REQUIRE(store.size(sub_2) == 0);
+
+    auto ev_4 = store.get(sub_1);
+    sim.run();
+    REQUIRE(*ev_4.value() == 2);
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("unsubscribe() releases unread values and aborts gets") {
+    auto sub_1 = store.subscribe(), sub_2 = store.subscribe();
+    store.put(1);
+    auto ev_1 = store.get(sub_1), ev_2 = store.get(sub_1);
+    REQUIRE(store.size() == 1);
+
+    store.unsubscribe(sub_2);
+    REQUIRE(store.size() == 0);
+    REQUIRE(store.subscribers() == 1);
+
+    store.unsubscribe(sub_1);
+    sim.run();
+    REQUIRE(ev_1.processed());
+    REQUIRE(ev_2.aborted());
+  }
+}
+
+simcpp20::event<> ps_job(simcpp20::simulation<> &sim,
+                         simcpp20::processor_sharing<> &server, double arrival,
+                         double work, double weight, double &finished) {
+  co_await sim.timeout(arrival);
+  co_await server.serve(work, weight);
+  finished = sim.now();
+}
+
+TEST_CASE("processor sharing") {
+  simcpp20::simulation<> sim;
+  simcpp20::processor_sharing<> server{sim};
+  double finished_1 = -1, finished_2 = -1;
+
+  SECTION("jobs share the rate equally") {
+    ps_job(sim, server, 0, 4, 1, finished_1);
+    ps_job(sim, server, 1, 2, 1, finished_2);
+    sim.run();
+
+    REQUIRE(std::abs(finished_1 - 6) < 1e-9);
+    REQUIRE(std::abs(finished_2 - 5) < 1e-9);
+    REQUIRE(server.jobs() == 0);
+  }
+
+  SECTION("jobs share the rate by weight") {
+    ps_job(sim, server, 0, 2, 1, finished_1);
+    ps_job(sim, server, 0, 2, 3, finished_2);
+    sim.run();
+
+    REQUIRE(std::abs(finished_1 - 4) < 1e-9);
+    REQUIRE(std::abs(finished_2 - 8. / 3) < 1e-9);
+  }
+
+  SECTION("aborted job is withdrawn") {
+    ps_job(sim, server, 0, 4, 1, finished_1);
+    auto ev = server.serve(4);
+    sim.run_until(2);
+    ev.abort();
+    sim.run();
+
+    REQUIRE(std::abs(finished_1 - 5) < 1e-9);
+    REQUIRE(server.jobs() == 0);
+  }
+}
+
+TEST_CASE("processor sharing with integral time") {
+  simcpp20::simulation<long> sim;
+  simcpp20::processor_sharing<long> server{sim, 3};
+  long finished = -1;
+  server.serve(1).add_callback([&](const auto &) { finished = sim.now(); });
+  sim.run_until(100);
+
+  // the departure is rounded up to the next unit of time
+  REQUIRE(finished == 1);
+  REQUIRE(server.jobs() == 0);
+}
+
+TEST_CASE("resource with scheduled capacity") {
+  simcpp20::simulation<> sim;
+  simcpp20::resource<> resource{sim, 1};
+
+  SECTION("increase grants waiting requests") {
+    auto ev_1 = resource.request(), ev_2 = resource.request();
+    resource.schedule_capacity(2, 2);
+    sim.run_until(1);
+    REQUIRE(ev_2.pending());
+
+    sim.run();
+    REQUIRE(ev_2.processed());
+    REQUIRE(sim.now() == 2);
+    REQUIRE(resource.capacity() == 2);
+  }
+
+  SECTION("decrease is deferred until units are released") {
+    auto ev_1 = resource.request();
+    resource.set_capacity(0);
+    REQUIRE(resource.capacity() == 0);
+
+    resource.release();
+    auto ev_2 = resource.request();
+    sim.run();
+    REQUIRE(ev_2.pending());
+    REQUIRE(resource.available() == 0);
+
+    resource.set_capacity(1);
+    sim.run();
+    REQUIRE(ev_2.processed());
+  }
+
+  SECTION("capacity follows a repeating calendar") {
+    resource.schedule_capacity({{1, 0}, {2, 1}}, 10);
+    std::vector<uint64_t> capacities;
+    for (double t : {0.5, 1.5, 2.5, 11.5, 12.5}) {
+      sim.run_until(t);
+      capacities.push_back(resource.capacity());
+    }
+
+    REQUIRE(capacities == std::vector<uint64_t>{1, 0, 1, 0, 1});
+  }
+
+  SECTION("a calendar without a period ends after its last change") {
+    auto calendar = resource.schedule_capacity({{2, 3}, {1, 2}});
+    sim.run();
+
+    REQUIRE(calendar.processed());
+    REQUIRE(sim.now() == 2);
+    REQUIRE(resource.capacity() == 3);
+  }
+
+  SECTION("aborting a repeating calendar stops it") {
+    auto calendar = resource.schedule_capacity({{1, 0}, {2, 1}}, 10);
+    sim.timeout(15).add_callback([calendar](const auto &) {
+      calendar.abort();
+    });
+    sim.run();
+
+    // the changes already scheduled for the next period fire without effect
+    REQUIRE(sim.now() == 22);
+    REQUIRE(resource.capacity() == 1);
+  }
+
+  SECTION("destroying the resource cancels its calendars") {
+    auto owned = std::make_unique<simcpp20::resource<>>(sim, 1);
+    owned->schedule_capacity({{1, 0}, {2, 1}}, 10);
+    owned->schedule_capacity(5, 2);
+    sim.run_until(3);
+    owned.reset();
+    sim.run();
+
+    REQUIRE(sim.now() == 12);
+  }
+}
+
+TEST_CASE("server pool") {
+  simcpp20::simulation<> sim;
+
+  SECTION("shortest queue dispatch") {
+    simcpp20::server_pool<> pool{sim, {1, 1, 1}};
+    std::vector<simcpp20::value_event<std::size_t>> evs;
+    for (int i = 0; i < 4; ++i) {
+      evs.push_back(pool.submit(1));
+    }
+    REQUIRE(pool.jobs(0) == 2);
+    sim.run();
+
+    REQUIRE(evs[0].value() == 0);
+    REQUIRE(evs[1].value() == 1);
+    REQUIRE(evs[2].value() == 2);
+    REQUIRE(evs[3].value() == 0);
+    REQUIRE(sim.now() == 2);
+  }
+
+  SECTION("least work left dispatch accounts for speeds") {
+    simcpp20::server_pool<> pool{sim, {1, 2},
+                                 simcpp20::dispatch_policy::least_work_left};
+    std::vector<simcpp20::value_event<std::size_t>> evs;
+    for (int i = 0; i < 4; ++i) {
+      evs.push_back(pool.submit(2));
+    }
+    sim.run();
+
+    REQUIRE(evs[0].value() == 0);
+    REQUIRE(evs[1].value() == 1);
+    REQUIRE(evs[2].value() == 1);
+    REQUIRE(evs[3].value() == 0);
+    REQUIRE(sim.now() == 4);
+  }
+
+  SECTION("round robin dispatch and withdrawn jobs") {
+    simcpp20::server_pool<> pool{sim, {1, 1},
+                                 simcpp20::dispatch_policy::round_robin};
+    auto ev_1 = pool.submit(1), ev_2 = pool.submit(1), ev_3 = pool.submit(1);
+    REQUIRE(pool.jobs(0) == 2);
+    ev_3.abort();
+    REQUIRE(pool.jobs(0) == 1);
+    sim.run();
+
+    REQUIRE(ev_1.value() == 0);
+    REQUIRE(ev_2.value() == 1);
+    REQUIRE(sim.now() == 1);
+  }
+
+  SECTION("withdrawn jobs no longer count as work left") {
+    simcpp20::server_pool<> pool{sim, {1, 1},
+                                 simcpp20::dispatch_policy::least_work_left};
+    pool.submit(4);
+    pool.submit(1);
+    pool.submit(2);
+    auto ev = pool.submit(5);
+    REQUIRE(pool.jobs(1) == 3);
+    ev.abort();
+
+    auto ev_2 = pool.submit(1);
+    REQUIRE(pool.jobs(1) == 3);
+    sim.run();
+    REQUIRE(ev_2.value() == 1);
+  }
+
+  SECTION("power of d dispatch serves all jobs") {
+    simcpp20::server_pool<> pool{sim, std::vector<double>(100, 1),
+                                 simcpp20::dispatch_policy::power_of_d};
+    std::size_t served = 0;
+    for (int i = 0; i < 1000; ++i) {
+      pool.submit(1).add_callback([&](const auto &) { ++served; });
+    }
+    sim.run();
+
+    REQUIRE(served == 1000);
+  }
+}
+
+TEST_CASE("token bucket") {
+  simcpp20::simulation<> sim;
+  simcpp20::token_bucket<> bucket{sim, 2, 4, 4};
+
+  SECTION("acquire() waits exactly until enough tokens accumulate") {
+    auto ev_1 = bucket.acquire(3), ev_2 = bucket.acquire(3),
+         ev_3 = bucket.acquire(1);
+    std::vector<double> times;
+    for (auto &ev : {ev_1, ev_2, ev_3}) {
+      ev.add_callback([&](const auto &) { times.push_back(sim.now()); });
+    }
+    sim.run();
+
+    REQUIRE(times == std::vector<double>{0, 1, 1.5});
+    REQUIRE(bucket.tokens() == 0);
+  }
+
+  SECTION("tokens are capped at the size of the bucket") {
+    REQUIRE(bucket.try_acquire(4));
+    REQUIRE(!bucket.try_acquire(1));
+    sim.timeout(10);
+    sim.run();
+
+    REQUIRE(bucket.tokens() == 4);
+  }
+
+  SECTION("aborted acquire() at the front unblocks the next one") {
+    bucket.try_acquire(4);
+    auto ev_1 = bucket.acquire(4), ev_2 = bucket.acquire(1);
+    double granted = -1;
+    ev_2.add_callback([&](const auto &) { granted = sim.now(); });
+    sim.run_until(0.25);
+    ev_1.abort();
+    sim.run();
+
+    REQUIRE(granted == 0.5);
+  }
+
+  SECTION("aborted acquire() behind the front keeps the timeout") {
+    bucket.try_acquire(4);
+    auto ev = bucket.acquire(4);
+    for (int i = 0; i < 3; ++i) {
+      bucket.acquire(1).abort();
+    }
+    int steps = 0;
+    while (!sim.empty()) {
+      sim.step();
+      ++steps;
+    }
+
+    // only the timeout and the grant, no aborted timeouts
+    REQUIRE(steps == 2);
+    REQUIRE(ev.processed());
+    REQUIRE(sim.now() == 2);
+  }
+}
+
+TEST_CASE("token bucket with integral time") {
+  simcpp20::simulation<long> sim;
+  simcpp20::token_bucket<long> bucket{sim, 3, 5, 0};
+  long granted = -1;
+  bucket.acquire(1).add_callback([&](const auto &) { granted = sim.now(); });
+  sim.run_until(100);
+
+  // the refill is rounded up to the next unit of time
+  REQUIRE(granted == 1);
+  REQUIRE(bucket.waiting() == 0);
+}
+
+simcpp20::event<> interruptible(simcpp20::simulation<> &sim,
+                                simcpp20::event<> ev, std::string &log) {
+  try {
+    co_await ev;
+    log += "done@" + std::to_string(int(sim.now()));
+  } catch (const simcpp20::interrupted &e) {
+    log += std::any_cast<std::string>(e.cause()) + "@" +
+           std::to_string(int(sim.now()));
+  }
+}
+
+TEST_CASE("interrupt") {
+  simcpp20::simulation<> sim;
+  std::string log;
+
+  SECTION("interrupt() wakes the process with the cause") {
+    auto timeout = sim.timeout(10);
+    auto proc = interruptible(sim, timeout, log);
+    sim.run_until(3);
+    proc.interrupt(std::string{"failure"});
+    sim.run();
+
+    REQUIRE(log == "failure@3");
+    REQUIRE(proc.processed());
+    REQUIRE(timeout.processed());
+  }
+
+  SECTION("aborting the awaited event after interrupt() keeps the process") {
+    auto ev = sim.event();
+    auto proc = interruptible(sim, ev, log);
+    sim.run();
+    proc.interrupt(std::string{"failure"});
+    ev.abort();
+    sim.run();
+
+    REQUIRE(log == "failure@0");
+  }
+
+  SECTION("interrupt() before the process starts is delivered later") {
+    auto proc = interruptible(sim, sim.timeout(10), log);
+    proc.interrupt(std::string{"early"});
+    sim.run();
+
+    REQUIRE(log == "early@0");
+  }
+
+  SECTION("interrupt() of a finished process does nothing") {
+    auto proc = interruptible(sim, sim.timeout(1), log);
+    sim.run();
+    proc.interrupt(std::string{"late"});
+    sim.run();
+
+    REQUIRE(log == "done@1");
+  }
+}
+
+simcpp20::event<> failing_parent(simcpp20::simulation<> &sim,
+                                 std::string &log) {
+  try {
+    co_await failing(sim);
+  } catch (const std::runtime_error &e) {
+    log += std::string{e.what()} + "@" + std::to_string(int(sim.now()));
+  }
+}
+
+simcpp20::event<> checked_getter(simcpp20::simulation<> &sim,
+                                 simcpp20::value_event<int> get,
+                                 std::string &log) {
+  auto result = co_await get.checked();
+  log += result ? std::to_string(*result.value) : "aborted";
+  log += "@" + std::to_string(int(sim.now()));
+}
+
+TEST_CASE("checked await") {
+  simcpp20::simulation<> sim;
+  std::string log;
+
+  SECTION("a processed event is reported") {
+    checked_waiter(sim, sim.timeout(1), log);
+    sim.run();
+
+    REQUIRE(log == "processed@1");
+  }
+
+  SECTION("an aborted event resumes the process instead of destroying it") {
+    auto ev = sim.event();
+    auto proc = checked_waiter(sim, ev, log);
+    sim.timeout(2).add_callback([ev](const auto &) { ev.abort(); });
+    sim.run();
+
+    REQUIRE(log == "aborted@2");
+    REQUIRE(proc.processed());
+  }
+
+  SECTION("an event aborted before awaiting is reported") {
+    auto ev = sim.event();
+    ev.abort();
+    checked_waiter(sim, ev, log);
+    sim.run();
+
+    REQUIRE(log == "aborted@0");
+  }
+
+  SECTION("an interrupt is reported") {
+    auto proc = checked_waiter(sim, sim.timeout(10), log);
+    sim.run_until(3);
+    proc.interrupt(std::string{"interrupted"});
+    sim.run();
+
+    REQUIRE(log == "interrupted@3");
+  }
+
+  SECTION("an exception of an awaited process is reported") {
+    checked_waiter(sim, failing(sim), log);
+    sim.run();
+
+    REQUIRE(log == "failed@2");
+  }
+
+  SECTION("an exception of an awaited process is rethrown") {
+    auto proc = failing_parent(sim, log);
+    sim.run();
+
+    REQUIRE(log == "failure@2");
+    REQUIRE(proc.processed());
+  }
+
+  SECTION("a checked get returns the value") {
+    simcpp20::store<int> store{sim};
+    checked_getter(sim, store.get(), log);
+    sim.timeout(1).add_callback([&](const auto &) { store.put(1); });
+    sim.run();
+
+    REQUIRE(log == "1@1");
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("a checked get reports its abort") {
+    simcpp20::store<int> store{sim};
+    auto get = store.get();
+    checked_getter(sim, get, log);
+    sim.timeout(2).add_callback([get](const auto &) { get.abort(); });
+    sim.run();
+
+    REQUIRE(log == "aborted@2");
+    REQUIRE(store.waiting() == 0);
+  }
+
+  SECTION("an exception nobody awaits is rethrown from run()") {
+    auto proc = failing(sim);
+    REQUIRE_THROWS_AS(sim.run(), std::runtime_error);
+    REQUIRE(sim.now() == 2);
+    REQUIRE(proc.processed());
+    REQUIRE(proc.exception() != nullptr);
+  }
+
+  SECTION("a defused exception is not rethrown") {
+    failing(sim).defuse();
+    sim.run();
+
+    REQUIRE(sim.now() == 2);
+  }
+
+  SECTION("a callback does not handle an exception") {
+    failing(sim).add_callback([&](const auto &) { log += "called"; });
+    REQUIRE_THROWS_AS(sim.run(), std::runtime_error);
+    REQUIRE(log == "called");
+  }
+
+  SECTION("an exception is passed on through |") {
+    checked_waiter(sim, failing(sim) | sim.timeout(5), log);
+    sim.run();
+
+    REQUIRE(log == "failed@2");
+  }
+
+  SECTION("an exception is passed on through &") {
+    auto ev = failing(sim) & sim.timeout(1);
+    REQUIRE_THROWS_AS(sim.run(), std::runtime_error);
+    REQUIRE(sim.now() == 2);
+    REQUIRE(ev.exception() != nullptr);
+  }
+}
+
+simcpp20::event<> session(simcpp20::simulation<> &sim, simcpp20::event<> ev,
+                          std::shared_ptr<int> state, std::string &log) {
+  co_await ev;
+  log += "done" + std::to_string(*state) + "@" + std::to_string(int(sim.now()));
+}
+
+simcpp20::event<> store_session(simcpp20::simulation<> &sim,
+                                simcpp20::store<int> &store,
+                                std::string &log) {
+  auto value = co_await store.get();
+  log += std::to_string(value) + "@" + std::to_string(int(sim.now()));
+}
+
+simcpp20::event<> reneging(simcpp20::simulation<> &sim,
+                           simcpp20::resource<> &resource, std::string &log) {
+  co_await (resource.request() | sim.timeout(5));
+  log += "served@" + std::to_string(int(sim.now()));
+}
+
+TEST_CASE("cancel") {
+  simcpp20::simulation<> sim;
+  std::string log;
+  auto state = std::make_shared<int>(1);
+
+  SECTION("cancel() destroys the frame and aborts the process event") {
+    auto timeout = sim.timeout(10);
+    auto proc = session(sim, timeout, state, log);
+    sim.run_until(3);
+    proc.cancel();
+
+    REQUIRE(state.use_count() == 1);
+    REQUIRE(proc.aborted());
+
+    sim.run();
+    REQUIRE(log == "");
+    REQUIRE(timeout.processed());
+  }
+
+  SECTION("cancel() before the process starts") {
+    auto proc = session(sim, sim.timeout(1), state, log);
+    proc.cancel();
+    sim.run();
+
+    REQUIRE(state.use_count() == 1);
+    REQUIRE(log == "");
+  }
+
+  SECTION("cancel() after an interrupt releases the awaited event") {
+    auto ev = sim.event();
+    auto proc = session(sim, ev, state, log);
+    sim.run();
+    proc.interrupt();
+    proc.cancel();
+    sim.run();
+
+    REQUIRE(state.use_count() == 1);
+    REQUIRE(log == "");
+    REQUIRE(ev.pending());
+  }
+
+  SECTION("processes awaiting a cancelled process see it aborted") {
+    auto ev = sim.event();
+    auto proc = session(sim, ev, state, log);
+    checked_waiter(sim, proc, log);
+    sim.run_until(2);
+    proc.cancel();
+    sim.run();
+
+    REQUIRE(log == "aborted@2");
+  }
+
+  SECTION("other processes awaiting the same event are kept") {
+    auto ev = sim.event();
+    auto cancelled = session(sim, ev, state, log);
+    auto kept = session(sim, ev, state, log);
+    sim.run();
+    cancelled.cancel();
+    ev.trigger();
+    sim.run();
+
+    REQUIRE(log == "done1@0");
+    REQUIRE(kept.processed());
+  }
+
+  SECTION("cancel() withdraws a get from a store") {
+    simcpp20::store<int> store{sim};
+    auto cancelled = store_session(sim, store, log);
+    sim.run();
+    REQUIRE(store.waiting() == 1);
+
+    cancelled.cancel();
+    REQUIRE(store.waiting() == 0);
+
+    store_session(sim, store, log);
+    sim.timeout(1).add_callback([&](const auto &) { store.put(1); });
+    sim.run();
+    REQUIRE(log == "1@1");
+    REQUIRE(store.size() == 0);
+  }
+
+  SECTION("cancel() withdraws a request awaited through any_of") {
+    simcpp20::resource<> resource{sim, 1};
+    resource.request();
+    auto cancelled = reneging(sim, resource, log);
+    sim.run_until(1);
+    REQUIRE(resource.waiting() == 1);
+
+    cancelled.cancel();
+    REQUIRE(resource.waiting() == 0);
+
+    auto later = resource.request();
+    resource.release();
+    sim.run();
+    REQUIRE(later.processed());
+    REQUIRE(resource.available() == 0);
+    REQUIRE(log == "");
+  }
+
+  SECTION("cancel() of a finished process does nothing") {
+    auto proc = session(sim, sim.timeout(1), state, log);
+    sim.run();
+    proc.cancel();
+
+    REQUIRE(proc.processed());
+    REQUIRE(log == "done1@1");
+  }
+}